@@ -0,0 +1,79 @@
+// Counts heap allocations and time per log() call, after a warm-up round.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <new>
+#include <string>
+
+#include "vs-logger/logger.hpp"
+
+static std::atomic<uint64_t> allocations{0};
+static std::atomic<bool> counting{false};
+
+void* operator new(size_t size) {
+    if (counting.load(std::memory_order_relaxed)) allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+template<typename F>
+static void run(const char *name, F &&body) {
+    constexpr int warmup = 10000, iterations = 200000;
+    for (int i = 0; i < warmup; i++) body(i);
+
+    allocations = 0;
+    counting = true;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) body(i);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    counting = false;
+
+    printf("%-36s %8.1f ns/call %10.3f allocs/call\n", name,
+           std::chrono::duration<double, std::nano>(elapsed).count() / iterations,
+           (double)allocations.load() / iterations);
+}
+
+int main() {
+    auto path = std::filesystem::temp_directory_path() / "vs-logger-bench.log";
+
+    // Format strings are measured both rendered (or deferred, in ASYNC mode) and interned, the default.
+    for (auto mode : {Logger::mode_t::SYNC, Logger::mode_t::ASYNC}) {
+        for (bool intern : {false, true}) {
+            std::filesystem::remove(path);
+            Logger::config_t config;
+            config.mode = mode;
+            config.overflow = Logger::overflow_t::BLOCK;
+            config.intern_formats = intern;
+            Logger logger(path, std::nullopt, config);
+            bool async = mode == Logger::mode_t::ASYNC;
+            auto name = [&](const char *row) {
+                return std::string(async ? "async " : "sync ") + row;
+            };
+
+            if (!intern) {
+                run(name("string_view").c_str(), [&](int) {
+                    logger.log(Logger::type_t::INFO, Logger::severity_t::LOW, "A constant log message");
+                });
+                run(name("fields").c_str(), [&](int i) {
+                    logger.log(Logger::type_t::INFO, Logger::severity_t::LOW, "Request served",
+                               {{"request", i}, {"client", "client"}, {"latency_ms", 0.5 * i}, {"cached", i % 2 == 0}});
+                });
+            }
+            run(name(intern ? "format (interned)" : async ? "format (deferred)" : "format").c_str(), [&](int i) {
+                logger.log(Logger::type_t::INFO, Logger::severity_t::LOW, 12345, 0, "Test log message number {} {}", i, 0.5 * i);
+            });
+            run(name(intern ? "format (string arg, interned)" : "format (string arg)").c_str(), [&](int i) {
+                logger.log(Logger::type_t::INFO, Logger::severity_t::LOW, 12345, 0, "Request {} from {}", i, std::string_view("client"));
+            });
+            logger.flush();
+        }
+    }
+    std::filesystem::remove(path);
+    return 0;
+}
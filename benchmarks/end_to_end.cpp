@@ -0,0 +1,186 @@
+// Latency from log() to the WebSocket client, through the UDS bridge of start_server().
+// Every message carries the steady clock time it was logged at, a minimal client on the other end
+// subtracts it from the time the frame carrying it was read. Entries are first logged at a steady
+// pace, then as fast as possible. Usage: bench-end-to-end [port] [sync]
+
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "vs-logger/logger.hpp"
+#include "stats.hpp"
+
+static uint64_t nowNs() {
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+// Just enough of a WebSocket client to read the text frames of the server.
+class ws_client {
+public:
+    bool connect(uint16_t port) {
+        for (int attempt = 0; attempt < 100; attempt++) {
+            sock = socket(AF_INET, SOCK_STREAM, 0);
+            struct sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(port);
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            if (::connect(sock, (struct sockaddr*)&addr, sizeof(addr)) == 0) break;
+            close(sock);
+            sock = -1;
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        if (sock < 0) return false;
+        int one = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        struct timeval timeout = {1, 0};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        std::string request = "GET /ws HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                              "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+        if (send(sock, request.data(), request.size(), 0) != (ssize_t)request.size()) return false;
+        size_t end;
+        while ((end = buffer.find("\r\n\r\n")) == std::string::npos)
+            if (!fill()) return false;
+        bool upgraded = buffer.starts_with("HTTP/1.1 101");
+        buffer.erase(0, end + 4);
+        return upgraded;
+    }
+
+    ~ws_client() {
+        if (sock >= 0) close(sock);
+    }
+
+    // Next text frame, empty on timeout or when the connection is closed.
+    std::string_view next() {
+        for (;;) {
+            buffer.erase(0, consumed);
+            consumed = 0;
+            while (buffer.size() < 2)
+                if (!fill()) return {};
+            uint8_t opcode = buffer[0] & 0x0f;
+            uint64_t length = buffer[1] & 0x7f;
+            size_t header = 2;
+            if (length >= 126) {
+                header += length == 126 ? 2 : 8;
+                while (buffer.size() < header)
+                    if (!fill()) return {};
+                length = 0;
+                for (size_t i = 2; i < header; i++) length = length << 8 | (uint8_t)buffer[i];
+            }
+            while (buffer.size() < header + length)
+                if (!fill()) return {};
+            consumed = header + length;
+            if (opcode == 0x8) return {};
+            if (opcode == 0x1) return std::string_view(buffer).substr(header, length);
+        }
+    }
+
+private:
+    bool fill() {
+        char chunk[64 * 1024];
+        ssize_t n = recv(sock, chunk, sizeof(chunk), 0);
+        if (n <= 0) return false;
+        buffer.append(chunk, n);
+        return true;
+    }
+
+    int sock = -1;
+    std::string buffer;
+    size_t consumed = 0;
+};
+
+// Read frames until count entries arrived or the server stays silent, recording their latency.
+static void receive(ws_client &client, size_t count, std::vector<uint64_t> &latencies, uint64_t &missed) {
+    constexpr std::string_view key = "\"message\":\"";
+    while (latencies.size() < count) {
+        auto frame = client.next();
+        if (frame.empty()) break;
+        uint64_t received = nowNs();
+        for (size_t pos = 0; pos < frame.size();) {
+            size_t end = frame.find('\n', pos);
+            auto line = frame.substr(pos, end - pos);
+            pos = end == std::string_view::npos ? frame.size() : end + 1;
+            uint64_t value;
+            if (line.starts_with("{\"missed\":")) {
+                if (std::from_chars(line.data() + 10, line.data() + line.size(), value).ec == std::errc()) missed += value;
+                continue;
+            }
+            size_t at = line.find(key);
+            if (at == std::string_view::npos) continue;
+            const char *first = line.data() + at + key.size();
+            if (std::from_chars(first, line.data() + line.size(), value).ec == std::errc())
+                latencies.push_back(received - value);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    uint16_t port = argc > 1 ? (uint16_t)atoi(argv[1]) : 18090;
+    bool sync = argc > 2 && std::string_view(argv[2]) == "sync";
+    auto udsPath = std::filesystem::temp_directory_path() / "vs-logger-bench-e2e.sock";
+
+    Logger::config_t config;
+    config.mode = sync ? Logger::mode_t::SYNC : Logger::mode_t::ASYNC;
+    config.overflow = Logger::overflow_t::BLOCK;
+    config.ws_history_entries = 0;
+    Logger logger(std::nullopt, udsPath, config);
+    logger.start_server(port);
+
+    ws_client client;
+    if (!client.connect(port)) {
+        fprintf(stderr, "Could not connect to the server on port %u\n", port);
+        return 1;
+    }
+    // Let the server register the client before anything is logged.
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    struct phase_t {
+        const char *name;
+        size_t count;
+        std::chrono::microseconds pace;
+    };
+    const phase_t phases[] = {{"paced 10k/s", 20000, std::chrono::microseconds(100)},
+                              {"burst", 200000, std::chrono::microseconds(0)}};
+
+    for (auto &phase : phases) {
+        std::vector<uint64_t> latencies;
+        latencies.reserve(phase.count);
+        uint64_t missed = 0;
+        auto start = std::chrono::steady_clock::now();
+        std::thread producer([&]() {
+            auto next = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < phase.count; i++) {
+                if (phase.pace.count()) {
+                    next += phase.pace;
+                    while (std::chrono::steady_clock::now() < next) {}
+                }
+                logger.log(Logger::type_t::INFO, Logger::severity_t::LOW, 1, 0, "{}", nowNs());
+            }
+            logger.flush();
+        });
+        receive(client, phase.count, latencies, missed);
+        producer.join();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        char name[64];
+        snprintf(name, sizeof(name), "%s %s", sync ? "sync" : "async", phase.name);
+        latency_t::of(latencies).print(name, latencies.size() / seconds);
+        if (latencies.size() + missed < phase.count)
+            printf("  %zu entries not received\n", phase.count - latencies.size() - missed);
+        if (missed) printf("  %llu entries missed by the client queue\n", (unsigned long long)missed);
+    }
+    std::filesystem::remove(udsPath);
+    // The server thread is detached and never returns.
+    fflush(stdout);
+    _exit(0);
+}
@@ -0,0 +1,39 @@
+// Throughput of escape_json() with the vector path picked at runtime against the scalar one,
+// on clean text and on text where every 16th byte needs escaping.
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "vs-logger/json.hpp"
+
+template<typename F>
+static void run(const char *name, const std::string &text, F &&escape) {
+    std::vector<char> out(vs_logger::escaped_json_capacity(text.size()));
+    size_t iterations = std::max<size_t>((512u << 20) / text.size(), 1000), written = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) written += escape(out.data(), text);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    char label[64];
+    snprintf(label, sizeof(label), "%s %zuB", name, text.size());
+    printf("%-32s %8.2f GB/s %8.1f ns/call  (%zu bytes out)\n", label,
+           (double)text.size() * iterations / std::chrono::duration<double, std::nano>(elapsed).count(),
+           std::chrono::duration<double, std::nano>(elapsed).count() / iterations, written / iterations);
+}
+
+int main() {
+    for (size_t size : {16u, 256u, 4096u, 65536u}) {
+        std::string clean, dirty;
+        for (size_t i = 0; i < size; i++) {
+            clean += (char)('a' + i % 26);
+            dirty += i % 16 == 15 ? (i % 32 == 31 ? '"' : '\n') : (char)('a' + i % 26);
+        }
+        run("clean runtime", clean, [](char *dst, std::string_view s) { return vs_logger::escape_json(dst, s); });
+        run("clean scalar", clean, vs_logger::escape_json_scalar);
+        run("dirty runtime", dirty, [](char *dst, std::string_view s) { return vs_logger::escape_json(dst, s); });
+        run("dirty scalar", dirty, vs_logger::escape_json_scalar);
+    }
+    return 0;
+}
@@ -0,0 +1,95 @@
+// Time per entry of Logger::formatText()/formatJson() against the std::format rendering they replaced,
+// after checking both produce the same bytes.
+
+#include <chrono>
+#include <cstdio>
+#include <format>
+#include <iterator>
+#include <string>
+
+#include "vs-logger/json.hpp"
+#include "vs-logger/logger.hpp"
+
+static void referenceText(std::string &out, const Logger::log_entry_t &entry, std::string_view message) {
+    std::format_to(std::back_inserter(out), "[{}], {{{}}}, Activity: {} Seq: {} Parent: {} -- {}\n",
+        to_string(entry.type), to_string(entry.sev), entry.activity_uuid, entry.seq_id, entry.parent_uuid, message);
+}
+
+static void referenceJson(std::string &out, const Logger::log_entry_t &entry, std::string_view message) {
+    std::format_to(std::back_inserter(out),
+        "{{\"timestamp\":{},\"type\":\"{}\",\"severity\":\"{}\",\"activity_uuid\":\"{}\","
+        "\"seq_id\":{},\"parent_uuid\":\"{}\",\"message\":\"",
+        entry.timestamp, to_string(entry.type), to_string(entry.sev), entry.activity_uuid, entry.seq_id, entry.parent_uuid);
+    vs_logger::escape_json(out, message);
+    out += "\"}\n";
+}
+
+static Logger::log_entry_t entryAt(int i) {
+    Logger::log_entry_t entry{};
+    entry.type = (Logger::type_t)(i % 5);
+    entry.sev = (Logger::severity_t)(i % 4);
+    entry.timestamp = 1760000000000000 + i * 37;
+    entry.activity_uuid = 1000 + i % 64;
+    entry.seq_id = i;
+    entry.parent_uuid = i % 3 ? 0 : 18446744073709551615u;
+    return entry;
+}
+
+template<typename F>
+static void run(const char *name, std::string_view message, F &&format) {
+    constexpr int iterations = 2000000;
+    std::string out;
+    size_t bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        // Clear every 256 entries, as a flushed batch would.
+        if ((i & 255) == 0) {
+            bytes += out.size();
+            out.clear();
+        }
+        format(out, entryAt(i), message);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    bytes += out.size();
+
+    printf("%-32s %8.1f ns/entry %8.1f MB/s\n", name,
+           std::chrono::duration<double, std::nano>(elapsed).count() / iterations,
+           bytes / std::chrono::duration<double, std::micro>(elapsed).count());
+}
+
+int main() {
+    const std::string_view message = "Request 12345 from client served in 0.25 ms";
+
+    for (int i = 0; i < 1000; i++) {
+        std::string expected, actual;
+        referenceText(expected, entryAt(i), message);
+        Logger::formatText(actual, entryAt(i), message);
+        referenceJson(expected, entryAt(i), message);
+        Logger::formatJson(actual, entryAt(i), message);
+        if (expected != actual) {
+            printf("Mismatch at entry %d:\n%s%s", i, expected.c_str(), actual.c_str());
+            return 1;
+        }
+    }
+
+    run("text std::format", message, referenceText);
+    run("text tables", message, [](std::string &out, const Logger::log_entry_t &entry, std::string_view message) {
+        Logger::formatText(out, entry, message);
+    });
+    run("json std::format", message, referenceJson);
+    run("json tables", message, [](std::string &out, const Logger::log_entry_t &entry, std::string_view message) {
+        Logger::formatJson(out, entry, message);
+    });
+
+    // Rendering of typed fields, encoded once as log() would.
+    vs_logger::fields_t fields = {{"request", 123456}, {"client", "10.0.0.1"}, {"latency_ms", 12.5}, {"cached", true}};
+    std::string encoded(vs_logger::encoded_fields_size(fields), '\0');
+    vs_logger::encode_fields(encoded.data(), fields);
+    run("text tables + 4 fields", message, [&](std::string &out, const Logger::log_entry_t &entry, std::string_view message) {
+        Logger::formatText(out, entry, message, encoded);
+    });
+    run("json tables + 4 fields", message, [&](std::string &out, const Logger::log_entry_t &entry, std::string_view message) {
+        Logger::formatJson(out, entry, message, encoded);
+    });
+    return 0;
+}
@@ -0,0 +1,130 @@
+// Latency percentiles and throughput of log() for every backend and mode, from 1 to 64 threads
+// and for messages from 16 B to 64 KiB. UDS runs drain the socket with a sink thread standing in
+// for the server. An argument only runs the cases whose name contains it.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "vs-logger/logger.hpp"
+#include "stats.hpp"
+
+// Receives and discards the datagrams of a Logger.
+class uds_sink {
+public:
+    explicit uds_sink(const std::filesystem::path &path) : path(path) {
+        std::filesystem::remove(path);
+        sock = socket(AF_UNIX, SOCK_DGRAM, 0);
+        struct sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        struct timeval timeout = {0, 100000};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        if (sock < 0 || bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) perror("uds_sink");
+        thread = std::thread([this]() {
+            std::vector<char> buffer(64 * 1024);
+            while (!stopping.load(std::memory_order_relaxed)) recv(sock, buffer.data(), buffer.size(), 0);
+        });
+    }
+
+    ~uds_sink() {
+        stopping = true;
+        thread.join();
+        close(sock);
+        std::filesystem::remove(path);
+    }
+
+private:
+    std::filesystem::path path;
+    int sock = -1;
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+};
+
+struct backend_t {
+    const char *name;
+    bool file, uds;
+};
+
+static void run(const backend_t &backend, Logger::mode_t mode, unsigned threads, size_t size, const char *filter) {
+    bool async = mode == Logger::mode_t::ASYNC;
+    char name[64];
+    snprintf(name, sizeof(name), "%s %s %ut %zuB", backend.name, async ? "async" : "sync", threads, size);
+    if (filter && !strstr(name, filter)) return;
+
+    auto dir = std::filesystem::temp_directory_path();
+    auto filePath = dir / "vs-logger-bench-latency.log";
+    auto udsPath = dir / "vs-logger-bench-latency.sock";
+    std::filesystem::remove(filePath);
+
+    // Enough entries for a stable p999, bounded to 256 MiB of messages.
+    size_t total = std::clamp<size_t>((256u << 20) / size, 20000, 400000);
+    size_t perThread = std::max<size_t>(total / threads, 1000);
+    std::string message(size, 'x');
+
+    std::vector<std::vector<uint64_t>> samples(threads);
+    std::chrono::steady_clock::duration elapsed;
+    {
+        std::optional<uds_sink> sink;
+        if (backend.uds) sink.emplace(udsPath);
+
+        Logger::config_t config;
+        config.mode = mode;
+        config.overflow = Logger::overflow_t::BLOCK;
+        Logger logger(backend.file ? std::optional(filePath) : std::nullopt,
+                      backend.uds ? std::optional(udsPath) : std::nullopt, config);
+
+        std::atomic<unsigned> ready{0};
+        std::atomic<bool> go{false};
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; t++) {
+            workers.emplace_back([&, t]() {
+                auto &latencies = samples[t];
+                latencies.reserve(perThread);
+                ready++;
+                while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+                for (size_t i = 0; i < perThread; i++) {
+                    auto start = std::chrono::steady_clock::now();
+                    logger.log(Logger::type_t::INFO, Logger::severity_t::LOW, message, t + 1);
+                    latencies.push_back((std::chrono::steady_clock::now() - start).count());
+                }
+            });
+        }
+        while (ready.load() < threads) std::this_thread::yield();
+
+        auto start = std::chrono::steady_clock::now();
+        go.store(true, std::memory_order_release);
+        for (auto &worker : workers) worker.join();
+        // Throughput counts until everything reached the backends, not only the log() calls.
+        logger.flush();
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+    std::filesystem::remove(filePath);
+    std::filesystem::remove(filePath.string() + ".idx");
+
+    std::vector<uint64_t> all;
+    all.reserve(perThread * threads);
+    for (auto &latencies : samples) all.insert(all.end(), latencies.begin(), latencies.end());
+    latency_t::of(all).print(name, all.size() / std::chrono::duration<double>(elapsed).count());
+}
+
+int main(int argc, char **argv) {
+    const char *filter = argc > 1 ? argv[1] : nullptr;
+    const backend_t backends[] = {{"file", true, false}, {"uds", false, true}, {"file+uds", true, true}};
+
+    for (auto mode : {Logger::mode_t::SYNC, Logger::mode_t::ASYNC}) {
+        for (auto &backend : backends) {
+            for (unsigned threads : {1u, 2u, 4u, 8u, 16u, 32u, 64u}) run(backend, mode, threads, 64, filter);
+            for (size_t size : {16u, 256u, 4096u, 65536u}) run(backend, mode, 1, size, filter);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Latency distribution of a benchmark run, in nanoseconds.
+struct latency_t {
+    uint64_t p50 = 0, p99 = 0, p999 = 0, max = 0;
+
+    static latency_t of(std::vector<uint64_t> &samples) {
+        latency_t result;
+        if (samples.empty()) return result;
+        std::sort(samples.begin(), samples.end());
+        auto at = [&](double q) { return samples[std::min(samples.size() - 1, (size_t)(q * samples.size()))]; };
+        result.p50 = at(0.5);
+        result.p99 = at(0.99);
+        result.p999 = at(0.999);
+        result.max = samples.back();
+        return result;
+    }
+
+    void print(const char *name, double entriesPerSecond) const {
+        printf("%-44s p50 %9.2f us  p99 %9.2f us  p999 %9.2f us  max %9.2f us  %10.0f entries/s\n", name,
+               p50 / 1e3, p99 / 1e3, p999 / 1e3, max / 1e3, entriesPerSecond);
+    }
+};
@@ -2,7 +2,6 @@
 #include <filesystem>
 #include <thread>
 #include <iostream>
-#include <format>
 
 #include "vs-logger/logger.hpp"
 
@@ -14,8 +13,8 @@ int main() {
     // Simulate generating log messages.
     for (int i = 0; i < 100; i++) {
         logger.log((Logger::type_t)(random()%5), (Logger::severity_t)(random()%4),
-                   std::format("Test log message number {}",i + 1),
-                   /* activity_uuid */ 12345);
+                   /* activity_uuid */ 12345, /* parent_uuid */ 0,
+                   "Test log message number {}", i + 1);
         std::this_thread::sleep_for(std::chrono::milliseconds(1000));
     }
 
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "segment.hpp"
+
+namespace vs_logger {
+
+// Path of the n-th segment of a log file, "<path>.<n>".
+std::filesystem::path segment_path(const std::filesystem::path &path, uint64_t n);
+
+// Numbers of the existing "<path>.<n>" and "<path>.<n>.z" segments, in increasing order,
+// each flagged when it is compressed. A segment being compressed is listed twice.
+std::vector<std::pair<uint64_t, bool>> list_segments(const std::filesystem::path &path);
+
+// Compress the segment at path into "<path>.z" (see segment.hpp) and remove the original.
+// On failure the original is left untouched.
+bool compress_segment(const std::filesystem::path &path, size_t block_size = 256 * 1024);
+
+// Random access to the raw bytes of a compressed segment.
+class compressed_segment {
+public:
+    // Takes ownership of fd.
+    explicit compressed_segment(int fd);
+    ~compressed_segment();
+
+    // Delete copy semantics.
+    compressed_segment(const compressed_segment&) = delete;
+    compressed_segment& operator=(const compressed_segment&) = delete;
+
+    bool is_open() const { return fd >= 0; }
+    uint64_t size() const { return header.raw_size; }
+
+    // Copy n raw bytes from offset, inflating the blocks they span. The last block stays cached.
+    bool read(uint64_t offset, void *dst, size_t n) const;
+
+private:
+    bool load(uint32_t block) const;
+
+    int fd = -1;
+    compressed_header_t header{};
+    std::vector<uint64_t> blockEnds;
+
+    mutable uint32_t cachedBlock = UINT32_MAX;
+    mutable std::string cache;
+    mutable std::string packed;
+};
+
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace vs_logger {
+
+// Where log() takes its timestamps from.
+//   STEADY: CLOCK_MONOTONIC, through the vDSO.
+//   COARSE: CLOCK_MONOTONIC_COARSE, cheaper still but only as precise as the kernel tick.
+//   TSC:    the CPU counter (rdtsc, CNTVCT_EL0), falls back to STEADY when it is not invariant.
+enum struct clock_source_t {
+    STEADY, COARSE, TSC
+};
+
+// Timestamps are taken as raw readings by the logging threads, and only turned into wall-clock
+// microseconds since the UNIX epoch by the writer, so entries of different processes line up.
+// The conversion is a linear fit against CLOCK_REALTIME, refreshed every calibration interval.
+// Converted timestamps never go backwards, so they stay sorted along a log file. When CLOCK_REALTIME
+// steps back, the clock keeps running ahead of it and catches up at slew_rate: a step back of N seconds
+// is absorbed in N / slew_rate seconds, timestamps meanwhile advancing at 1 - slew_rate of the real pace.
+class log_clock {
+public:
+    static constexpr double slew_rate = 0.1;
+
+    explicit log_clock(clock_source_t source = clock_source_t::STEADY,
+                       std::chrono::milliseconds calibration_interval = std::chrono::milliseconds(1000));
+
+    // Continue after wall, the last timestamp of a log file being appended to: if it is ahead of
+    // CLOCK_REALTIME, the clock catches up with it as it does after a step back. Same thread as to_wall().
+    void resume(uint64_t wall);
+
+    clock_source_t source() const { return clockSource; }
+
+    // Raw reading, the only part log() pays for.
+    uint64_t now() const {
+        switch (clockSource) {
+            case clock_source_t::TSC:    return ticks();
+            case clock_source_t::COARSE: return read(CLOCK_MONOTONIC_COARSE);
+            default:                     return read(CLOCK_MONOTONIC);
+        }
+    }
+
+    // Wall-clock microseconds of a raw reading, never less than the previous result.
+    // Calibrates again when due; only one thread may call it.
+    uint64_t to_wall(uint64_t raw);
+    // The same with the current calibration, changing nothing: for a thread which cannot take over from
+    // the one calling to_wall(), or must not take the time to calibrate.
+    uint64_t wall_of(uint64_t raw) const;
+
+    // Measure the raw clock against CLOCK_REALTIME again.
+    void calibrate() { reanchor(0); }
+
+private:
+    // Calibrate, keeping conversions from now on at or above floor and the current ones (nanoseconds).
+    void reanchor(uint64_t floor);
+    // Nanoseconds since the epoch of a raw reading.
+    int64_t wall_ns(uint64_t raw) const;
+
+    static uint64_t read(clockid_t id) {
+        struct timespec ts;
+        clock_gettime(id, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    }
+
+    static uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#elif defined(__aarch64__)
+        uint64_t value;
+        asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+        return value;
+#else
+        return read(CLOCK_MONOTONIC);
+#endif
+    }
+
+    // A raw reading with the monotonic and real time at the same instant, in nanoseconds.
+    struct sample_t {
+        uint64_t raw, mono, real;
+    };
+    sample_t sample() const;
+
+    clock_source_t clockSource;
+    std::chrono::nanoseconds interval;
+
+    sample_t origin{};          // First calibration, the rate is measured from it.
+    sample_t anchor{};          // Last calibration, conversions start from it.
+    int64_t ahead = 0;          // Nanoseconds the clock runs ahead of CLOCK_REALTIME at the anchor.
+    double nsPerTick = 1.0;
+    uint64_t nextCalibration = 0;   // Raw reading after which to calibrate again.
+    uint64_t lastWall = 0;
+};
+
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+
+namespace vs_logger {
+
+// Typed key/value fields of an entry, passed to Logger::log() as {{"key", value}, ...}.
+// They are encoded once by log() and travel in this binary form after the message: in the ASYNC
+// queue, in BINARY log files and through shared memory rings. They only become text when an
+// entry is rendered (text log, JSON for the web server), so nothing gets parsed back.
+//
+// Encoding, native byte order, no alignment: for every field its kind (uint8_t), the key length
+// (uint8_t) and key bytes, then the value: a varint for UINT, a zigzag varint for INT, 8 bytes for
+// DOUBLE, 1 for BOOL, 16 for UUID (high then low half), a varint length and the bytes for STRING.
+// Varints are LEB128: 7 bits per byte, low bits first, the high bit set on all but the last byte.
+enum struct field_kind_t : uint8_t {
+    INT, UINT, DOUBLE, BOOL, STRING, UUID
+};
+
+struct uuid_t {
+    uint64_t high = 0, low = 0;
+};
+
+// Encoded fields of an entry never exceed this, the fields which do not fit are dropped.
+inline constexpr size_t max_fields_bytes = 65535;
+
+inline constexpr size_t varint_size(uint64_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+inline char *put_varint(char *dst, uint64_t value) {
+    while (value >= 0x80) {
+        *dst++ = (char)(value | 0x80);
+        value >>= 7;
+    }
+    *dst++ = (char)value;
+    return dst;
+}
+
+// Read a varint at p, moving p past it. False if it runs past end or over 64 bits.
+inline bool get_varint(const char *&p, const char *end, uint64_t &value) {
+    value = 0;
+    for (unsigned shift = 0; p != end && shift < 64; shift += 7) {
+        uint8_t byte = (uint8_t)*p++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+struct field_t {
+    std::string_view key;
+    field_kind_t kind;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        bool b;
+        uuid_t uuid;
+    };
+    std::string_view text;   // STRING value, only viewed: it must outlive the log() call.
+
+    field_t(std::string_view key, bool value) : key(key), kind(field_kind_t::BOOL), b(value) {}
+    template<std::signed_integral T>
+    field_t(std::string_view key, T value) : key(key), kind(field_kind_t::INT), i(value) {}
+    template<std::unsigned_integral T>
+    field_t(std::string_view key, T value) : key(key), kind(field_kind_t::UINT), u(value) {}
+    template<std::floating_point T>
+    field_t(std::string_view key, T value) : key(key), kind(field_kind_t::DOUBLE), d(value) {}
+    field_t(std::string_view key, uuid_t value) : key(key), kind(field_kind_t::UUID), uuid(value) {}
+    field_t(std::string_view key, std::string_view value) : key(key), kind(field_kind_t::STRING), u(0), text(value) {}
+    field_t(std::string_view key, const char *value) : field_t(key, std::string_view(value)) {}
+    field_t(std::string_view key, const std::string &value) : field_t(key, std::string_view(value)) {}
+};
+
+using fields_t = std::initializer_list<field_t>;
+
+// Bytes encode_fields() writes for fields, at most max_fields_bytes.
+size_t encoded_fields_size(fields_t fields);
+// True if encode_fields() keeps every one of fields.
+bool fields_fit(fields_t fields);
+// Encode fields at dst, which must hold encoded_fields_size(fields) bytes. Returns the end.
+// Keys are cut at 255 bytes.
+char *encode_fields(char *dst, fields_t fields);
+
+// Call f(const field_t&) on every encoded field, the key and text viewing into encoded.
+// Returns false if the encoding is cut short, after the fields decoded so far.
+template<typename F>
+bool for_each_field(std::string_view encoded, F &&f) {
+    const char *p = encoded.data(), *end = p + encoded.size();
+    while (p != end) {
+        if (end - p < 2) return false;
+        auto kind = (field_kind_t)p[0];
+        size_t keyLength = (uint8_t)p[1];
+        p += 2;
+        if ((size_t)(end - p) < keyLength) return false;
+        std::string_view key(p, keyLength);
+        p += keyLength;
+
+        field_t field(key, int64_t(0));
+        field.kind = kind;
+        switch (kind) {
+            case field_kind_t::INT:
+            case field_kind_t::UINT:
+                if (!get_varint(p, end, field.u)) return false;
+                if (kind == field_kind_t::INT) field.i = (int64_t)(field.u >> 1) ^ -(int64_t)(field.u & 1);
+                break;
+            case field_kind_t::DOUBLE:
+                if (end - p < 8) return false;
+                memcpy(&field.d, p, 8);
+                p += 8;
+                break;
+            case field_kind_t::BOOL:
+                if (end - p < 1) return false;
+                field.b = *p++ != 0;
+                break;
+            case field_kind_t::UUID:
+                if (end - p < 16) return false;
+                memcpy(&field.uuid, p, 16);
+                p += 16;
+                break;
+            case field_kind_t::STRING: {
+                uint64_t length;
+                if (!get_varint(p, end, length) || (uint64_t)(end - p) < length) return false;
+                field.text = std::string_view(p, length);
+                p += length;
+                break;
+            }
+            default:
+                return false;
+        }
+        f(field);
+    }
+    return true;
+}
+
+// Render encoded fields as a JSON object, UUIDs as their usual 8-4-4-4-12 string.
+void fields_json(std::string &out, std::string_view encoded);
+// Render one value as in fields_json(), the canonical form web server filters compare against.
+void field_json(std::string &out, const field_t &field);
+// Render encoded fields for the text log format, as " key=value" for each of them.
+void fields_text(std::string &out, std::string_view encoded);
+
+}
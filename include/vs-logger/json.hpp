@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace vs_logger {
+
+// Worst case size of escaped text: every byte becomes "\u00XX".
+constexpr size_t escaped_json_capacity(size_t size) { return size * 6; }
+
+// Escape s as the contents of a JSON string into dst, which must hold at least
+// escaped_json_capacity(s.size()) bytes. Returns the number of bytes written.
+// Quotes, backslashes and every control byte below 0x20 are escaped, clean runs are
+// found 16/32 bytes at a time (SSE2, AVX2 or NEON, picked at runtime) and copied in bulk.
+size_t escape_json(char *dst, std::string_view s);
+
+// Append the escaped version of s to out.
+void escape_json(std::string &out, std::string_view s);
+
+// Portable reference implementation, always scalar.
+size_t escape_json_scalar(char *dst, std::string_view s);
+
+}
@@ -1,14 +1,40 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <cstddef>
 #include <filesystem>
+#include <format>
+#include <iterator>
+#include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <mutex>
-#include <fstream>
 #include <sys/un.h>
 #include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "clock.hpp"
+#include "fields.hpp"
+#include "templates.hpp"
+#include "metrics.hpp"
+#include "ring.hpp"
+#include "shm_ring.hpp"
+#include "site.hpp"
+
+// Entries below these levels are compiled out of VS_LOG() call sites.
+// Values are the integer value of Logger::type_t and Logger::severity_t.
+#ifndef VS_LOG_MIN_TYPE
+#define VS_LOG_MIN_TYPE 0
+#endif
+#ifndef VS_LOG_MIN_SEVERITY
+#define VS_LOG_MIN_SEVERITY 0
+#endif
 
 class Logger {
 public:
@@ -30,48 +56,495 @@ public:
 
         size_t offset;           // Offset in the log file.
         size_t length;           // Message length.
+        size_t fields_length;    // Encoded fields following the message, see vs-logger/fields.hpp.
+        // Interned format whose encoded arguments are the message, see vs-logger/templates.hpp.
+        // Zero when the message is text, which is always the case outside of the Logger.
+        uint32_t template_id;
+    };
+
+    // SYNC writes from the calling thread, ASYNC hands entries to a background writer.
+    enum struct mode_t {
+        SYNC, ASYNC
+    };
+
+    // What log() does in ASYNC mode when the queue is full.
+    enum struct overflow_t {
+        BLOCK, DROP, OVERWRITE
+    };
+
+    // Layout of the log file. BINARY also writes a "<file>.idx" offset index next to it.
+    enum struct format_t {
+        TEXT, BINARY
+    };
+
+    // Where the log file bytes go. MMAP preallocates fixed-size "<file>.<n>" segments and
+    // writes entries straight into a shared mapping of the current one.
+    enum struct storage_t {
+        STREAM, MMAP
+    };
+
+    // Where log() reads the time, see vs-logger/clock.hpp.
+    using clock_source_t = vs_logger::clock_source_t;
+
+    struct config_t {
+        mode_t mode = mode_t::SYNC;
+        format_t file_format = format_t::TEXT;
+        storage_t file_storage = storage_t::STREAM;
+        size_t segment_size = 256 * 1024 * 1024;   // Bytes per MMAP segment.
+        overflow_t overflow = overflow_t::BLOCK;
+        size_t queue_capacity = 1024;   // Entries per producer thread, rounded up to a power of two.
+        size_t batch_size = 256;        // Entries drained per producer thread and writer wakeup.
+
+        // VS_LOG call sites keep at most site_rate entries per second each, in bursts of up to site_burst
+        // (zero disables it), and entries at or below both sample_type and sample_severity are only kept
+        // with probability sample_ratio. PANIC and HIGH entries are never left out. Every
+        // suppression_interval, each call site reports what it left out as one entry of its own.
+        double site_rate = 0;
+        unsigned site_burst = 10;
+        double sample_ratio = 1.0;
+        type_t sample_type = type_t::INFO;
+        severity_t sample_severity = severity_t::LOW;
+        std::chrono::milliseconds suppression_interval{1000};
+
+        // Timestamps are taken from clock_source and written as wall-clock microseconds since the UNIX
+        // epoch, the conversion being calibrated against CLOCK_REALTIME every clock_calibration.
+        clock_source_t clock_source = clock_source_t::STEADY;
+        std::chrono::milliseconds clock_calibration{1000};
+
+        // Format strings of log(type, sev, activity_uuid, parent_uuid, "format {}", args...) are interned,
+        // and BINARY files and shared memory rings only get their id and the arguments. Text is rendered by
+        // the writer for the other outputs, and by LogReader and the server for those.
+        bool intern_formats = true;
+
+        // Group commit of the log file: entries are buffered and written once one of these is hit.
+        // ERROR and PANIC entries are always written right away, and in ASYNC mode log() returns from a
+        // PANIC entry once the writer has written out everything queued before it, or after crash_flush_timeout.
+        size_t flush_bytes = 64 * 1024;
+        std::chrono::microseconds flush_interval{5000};
+        std::chrono::milliseconds sync_interval{0};   // fdatasync() cadence, zero disables it.
+
+        // Handle SIGSEGV, SIGBUS, SIGFPE, SIGILL and SIGABRT to save what is still buffered before the
+        // previous handler (by default, the end of the process) runs. The thread writing entries, if it is a
+        // different one, is given crash_flush_timeout to write them out as usual, and nothing else is written
+        // if it does not make it. When the crashing thread is the one writing, the handler writes to the log
+        // file itself with raw write(2) calls, and queued entries which would need formatting go with their
+        // format string only.
+        bool crash_handler = false;
+        std::chrono::milliseconds crash_flush_timeout{500};
+
+        // STREAM log files are rotated to "<file>.<n>" (index included) once they reach rotate_bytes or
+        // get older than rotate_interval, zero disables either. MMAP segments rotate at segment_size.
+        size_t rotate_bytes = 0;
+        std::chrono::seconds rotate_interval{0};
+        // Rotated segments are compressed to "<file>.<n>.z" on a low priority thread, and only the most
+        // recent retain_segments are kept (zero keeps all of them).
+        bool compress_segments = false;
+        size_t retain_segments = 0;
+
+        // Entries sent over UDS are packed as newline-delimited JSON in datagrams up to this size (at most
+        // 64 KiB, the server's receive buffer). Larger entries are sent in fragments of this size.
+        size_t uds_datagram_bytes = 16 * 1024;
+        // Non-zero gives every UDS shard a shared memory ring of this size, handed to the server over its
+        // socket, and entries go through the ring instead of datagrams. The server must run on the same host.
+        // Entries larger than a quarter of the ring are cut in several records.
+        size_t shm_ring_bytes = 0;
+        // Entries are spread over this many UDS sockets by activity_uuid % uds_shards, so the server can
+        // ingest them on as many threads. Entries of the same activity always travel in order on one socket.
+        unsigned uds_shards = 1;
+        // Crow worker threads of start_server(), crow needs at least 2.
+        uint16_t server_threads = 2;
+
+        // WebSocket fan-out: entries waiting per client before the oldest are dropped, and frames
+        // in flight to a client that acknowledges them before it is sent more.
+        size_t ws_client_queue = 8192;
+        unsigned ws_client_window = 4;
+        // Recent entries kept by the server for clients replaying what they missed, zero disables it.
+        size_t ws_history_entries = 65536;
+        size_t ws_history_bytes = 16 * 1024 * 1024;
+        // zlib level (1-9) for clients asking for a deflated stream, zero keeps every client on text frames.
+        int ws_deflate_level = 6;
     };
 
     Logger(std::optional<std::filesystem::path> logFilePath = std::nullopt,
            std::optional<std::filesystem::path> udsPath = std::nullopt);
+    Logger(std::optional<std::filesystem::path> logFilePath,
+           std::optional<std::filesystem::path> udsPath,
+           const config_t &config);
     ~Logger();
 
     // Delete copy semantics.
     Logger(const Logger&) = delete;
     Logger& operator=(const Logger&) = delete;
 
+    // True if entries of this level survive the compile-time thresholds. PANIC always does.
+    static constexpr bool compiled_in(type_t type, severity_t sev) {
+        return type == type_t::PANIC ||
+               ((int)type >= VS_LOG_MIN_TYPE && (int)sev >= VS_LOG_MIN_SEVERITY);
+    }
+
+    // Change the runtime thresholds, entries below either of them are discarded. PANIC never is.
+    void set_level(type_t min_type, severity_t min_sev) {
+        minLevel.store((uint16_t)((int)min_type << 8 | (int)min_sev), std::memory_order_relaxed);
+    }
+
+    // True if log() would keep an entry of this level, checked before any formatting.
+    bool enabled(type_t type, severity_t sev) const {
+        uint16_t level = minLevel.load(std::memory_order_relaxed);
+        return type == type_t::PANIC || ((int)type >= (level >> 8) && (int)sev >= (level & 0xff));
+    }
+
+    // True if the rate limit and the sampling of site let an entry of this level through, which
+    // VS_LOG checks before evaluating its arguments. Free when neither is configured.
+    bool admit(vs_logger::log_site_t &site, type_t type, severity_t sev) {
+        if (!limiting || type == type_t::PANIC || sev == severity_t::HIGH) return true;
+        return admitSlow(site, type, sev);
+    }
+
     // Log a message with the given metadata.
     void log(type_t type,
              severity_t sev,
-             const std::string &message,
+             std::string_view message,
              uint64_t activity_uuid = 0,
              uint64_t parent_uuid = 0);
 
+    // Log a message with typed fields, log(type, sev, "message", {{"key", value}, ...}). The fields
+    // are encoded right away, without any heap allocation once warmed up.
+    void log(type_t type,
+             severity_t sev,
+             std::string_view message,
+             vs_logger::fields_t fields,
+             uint64_t activity_uuid = 0,
+             uint64_t parent_uuid = 0);
+
+    // Log a message rendered from a format string, without any heap allocation.
+    // With intern_formats, when all arguments are vs_logger::internable_arg, they are encoded along with
+    // the id of the format string, and only rendered by the outputs which need text. Otherwise in ASYNC
+    // mode, when all arguments are arithmetic they are copied in the queue slot and only rendered by the
+    // writer thread.
+    template<typename... Args>
+    void log(type_t type,
+             severity_t sev,
+             uint64_t activity_uuid,
+             uint64_t parent_uuid,
+             std::format_string<Args...> fmt,
+             Args&&... args) {
+        if (!enabled(type, sev)) return;
+
+        if constexpr ((vs_logger::internable_arg<std::remove_cvref_t<Args>> && ...)) {
+            if (config.intern_formats) {
+                if (uint32_t id = vs_logger::intern_format(fmt.get())) {
+                    vs_logger::fields_t values = {vs_logger::field_t(std::string_view(), args)...};
+                    if (vs_logger::fields_fit(values)) {
+                        log_entry_t entry = makeEntry(type, sev, activity_uuid, parent_uuid);
+                        entry.template_id = id;
+                        submit(entry, {}, values, {});
+                        return;
+                    }
+                }
+            }
+        }
+
+        using args_t = std::tuple<std::remove_cvref_t<Args>...>;
+        constexpr bool deferrable = (std::is_arithmetic_v<std::remove_cvref_t<Args>> && ...) &&
+                                    sizeof(args_t) <= record_t::inline_capacity &&
+                                    alignof(args_t) <= alignof(std::max_align_t);
+
+        if constexpr (deferrable) {
+            if (async) {
+                log_entry_t entry = makeEntry(type, sev, activity_uuid, parent_uuid);
+                enqueue(type, [&](record_t &record) {
+                    record.entry = entry;
+                    record.render = &renderArgs<std::remove_cvref_t<Args>...>;
+                    record.format = fmt.get();
+                    new (record.inline_message) args_t(std::forward<Args>(args)...);
+                });
+                return;
+            }
+        }
+
+        auto &buffer = formatBuffer();
+        buffer.clear();
+        std::format_to(std::back_inserter(buffer), fmt, std::forward<Args>(args)...);
+        log(type, sev, std::string_view(buffer), activity_uuid, parent_uuid);
+    }
+
+    // Render an entry as one line of the text log format, fields being the encoded ones.
+    static void formatText(std::string &out, const log_entry_t &entry, std::string_view message,
+                           std::string_view fields = {});
+    // Render an entry as the newline-terminated JSON object sent to the web server.
+    // Fields, if any, become a "fields" object right before the message, which always comes last.
+    static void formatJson(std::string &out, const log_entry_t &entry, std::string_view message,
+                           std::string_view fields = {});
+
+    // Write out everything logged so far (in ASYNC mode, wait for the writer to do it).
+    void flush();
+
+    // Counters since the Logger was created, readable from any thread. vs_logger::write_prometheus()
+    // renders them, start_server() also serves them on "/metrics".
+    using metrics_t = vs_logger::logger_metrics_t;
+    metrics_t metrics() const { return counters->snapshot(); }
+
     // Initialize the logger (open file, start web server, etc.).
     #ifndef LOG_HEADLESS
     void start_server(uint16_t port = 18080);
     #endif
 
+    // Socket of UDS shard n: the UDS path itself for shard 0, "<path>.<n>" for the others.
+    static std::filesystem::path uds_shard_path(const std::filesystem::path &udsPath, unsigned n);
+
 private:
-    // Write the log entry with message to the file.
-    void writeToFS(const log_entry_t& entry, const std::string &message);
-    // Send a notification (JSON payload) over UDS.
-    void writeToWS(const log_entry_t &entry, const std::string &message);
-    // Helper to get the current timestamp in microseconds.
-    static uint64_t getTimestamp();
+    // Fixed-size queue slot used in ASYNC mode.
+    struct record_t {
+        static constexpr size_t inline_capacity = 400;
+
+        log_entry_t entry;
+        std::string spill;                   // Only used for payloads above inline_capacity.
+        // Set for deferred formatting: inline_message then holds the arguments, not the text.
+        void (*render)(std::string &out, std::string_view format, const void *args) = nullptr;
+        std::string_view format;
+        alignas(std::max_align_t) char inline_message[inline_capacity];
+
+        // The message followed by the encoded fields.
+        std::string_view payload() const {
+            size_t size = entry.length + entry.fields_length;
+            return size <= inline_capacity ? std::string_view(inline_message, size) : std::string_view(spill);
+        }
+    };
+
+    // Write the log entry with message to the file, recording its offset in the entry.
+    void writeToFS(log_entry_t& entry, std::string_view message, std::string_view fields);
+    // Open the log file (and index), validating or writing the binary segment header.
+    void openLogFile(const std::filesystem::path &path);
+    // Open the sidecar index and resume seq_id and the clock from its last entry.
+    void openIndex(const std::filesystem::path &indexPath);
+    // Map MMAP segment number n, creating and preallocating it if needed.
+    void openSegment(uint64_t n);
+    // Unmap the current segment, trimming the file to the bytes actually used.
+    void closeSegment();
+    // Make room for size bytes in the current segment, rolling over to a new one if needed.
+    bool reserveSegment(size_t size);
+    // Write the buffered file contents with one syscall, fdatasync() if it is due.
+    void flushFile();
+    // True if the STREAM log file is due for rotation.
+    bool rotationDue(std::chrono::steady_clock::time_point now) const;
+    // Move the STREAM log file and its index to the next "<file>.<n>" and start a new one.
+    void rotateFile();
+    // Hand a finished segment to the archiver thread.
+    void archiveSegment(uint64_t n);
+    // Body of the archiver thread: compression and retention of finished segments.
+    void archiverLoop();
+    void applyRetention();
+    // Queue a notification (JSON payload) for UDS, packing it with the previous ones.
+    void writeToWS(const log_entry_t &entry, std::string_view message, std::string_view fields);
+    // Send all the queued datagrams with as few sendmmsg() calls as possible.
+    void flushWS();
+    struct uds_shard_t;
+    void flushWS(uds_shard_t &shard);
+    // Hand the ring of a shard to the server, again whenever it stays full in case the server restarted.
+    void announceRing(uds_shard_t &shard);
+    // Dispatch one entry to all the configured outputs.
+    void write(log_entry_t &entry, std::string_view message, std::string_view fields = {});
+    // Queue or write an entry which passed the level checks, its message being message followed by the
+    // encoded args (only for templated entries).
+    void submit(log_entry_t entry, std::string_view message, vs_logger::fields_t args, vs_logger::fields_t fields);
+    // Template of an interned format, cached for the writer.
+    const vs_logger::format_template_t *templateOf(uint32_t id);
+    // Text of an entry, rendered if it is templated. Only valid until the next entry is written.
+    std::string_view messageText(const log_entry_t &entry, std::string_view message);
+    // Reference to the template of an entry written at offset of the log file, defining it there if it
+    // is new to the file. Only for files of a version holding templates.
+    vs_logger::template_ref_t fileTemplateRef(uint32_t id, uint64_t offset);
+    // Per producer thread staging buffer used in ASYNC mode.
+    struct staging_t {
+        explicit staging_t(size_t capacity) : ring(capacity) {}
+
+        vs_logger::bounded_ring<record_t, true> ring;
+        std::atomic<bool> orphaned{false};   // Set when the producer thread exits.
+        std::atomic<bool> detached{false};   // Set when the Logger is destroyed.
+        size_t owed = 0;                     // Writer only: entries queued before the flush() being served.
+    };
+
+    // Entry waiting in the writer's merge batch, message and fields bytes live in mergeArena.
+    struct merged_t {
+        log_entry_t entry;
+        size_t arena_offset;
+    };
+
+    // Get (or register) the staging buffer of the calling thread for this Logger.
+    staging_t &localStaging();
+    // Place a record filled by fill(record_t&) in the thread's staging buffer, according to the overflow policy.
+    // PANIC entries are never dropped, and wait for the writer to write out the queues.
+    template<typename F>
+    void enqueue(type_t type, F &&fill) {
+        auto &staging = localStaging();
+        auto &ring = staging.ring;
+        while (!ring.try_push(fill)) {
+            if (config.overflow == overflow_t::DROP && type != type_t::PANIC) {
+                counters->dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            if (config.overflow == overflow_t::OVERWRITE) {
+                // Throw away the oldest entry to make room for the new one. A deferred one must not leave its
+                // renderer behind for whatever fills the cell next.
+                if (ring.try_pop([](record_t &record) { record.render = nullptr; }))
+                    counters->dropped.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            waitForWriter(staging);
+        }
+        notifyWriter();
+        if (type == type_t::PANIC) awaitWriter();
+    }
+    // Wait, at most crash_flush_timeout, for the writer to write out what is queued. Not on the writer
+    // thread itself, nor once the Logger is being destroyed.
+    void awaitWriter();
+    // True once the writer acknowledged flush request target, false if deadline comes first. Async-signal-safe.
+    bool waitFlushed(uint64_t target, std::chrono::steady_clock::time_point deadline) const;
+    // Wake the writer if it is idle.
+    void notifyWriter();
+    // Wake the writer and sleep until it took records off the queues, unless staging has room already
+    // (BLOCK policy).
+    void waitForWriter(staging_t &staging);
+    // Render deferred arguments on the writer thread.
+    template<typename... Ts>
+    static void renderArgs(std::string &out, std::string_view format, const void *args) {
+        std::apply([&](const Ts&... values) {
+            std::vformat_to(std::back_inserter(out), format, std::make_format_args(values...));
+        }, *(const std::tuple<Ts...>*)args);
+    }
+    // Per-thread buffers the synchronous path formats and encodes fields into.
+    static std::string &formatBuffer();
+    static std::string &fieldsBuffer();
+    // Fill the metadata of a new entry with a raw timestamp, sequence number and offset are assigned later.
+    log_entry_t makeEntry(type_t type, severity_t sev, uint64_t activity_uuid, uint64_t parent_uuid);
+    // Move up to batch_size entries per staging buffer into the merge batch, returns the count.
+    size_t collect(std::vector<std::shared_ptr<staging_t>> &buffers);
+    // Body of the background writer thread.
+    void writerLoop();
+    // Rate limiting and sampling behind admit().
+    bool admitSlow(vs_logger::log_site_t &site, type_t type, severity_t sev);
+    void suppress(vs_logger::log_site_t &site, type_t type, severity_t sev);
+    // Write a summary entry for every site which left entries out, when due or when forced, true if any.
+    // Only called by whoever owns the outputs: the writer thread, or write() callers under writeMutex.
+    bool reportSuppressed(bool force = false);
+    // Handler of the fatal signals of crash_handler, saving what every registered Logger still buffers.
+    static void crashSignal(int sig);
+    // Async-signal-safe: no allocation, and locks are only waited for until crash_flush_timeout.
+    void crashFlush();
+    // Write an entry the writer did not get to straight to the log file, as crashFlush() does.
+    void crashWrite(log_entry_t entry, std::string_view message, std::string_view fields);
 
     std::optional<std::filesystem::path> logFilePath;
     std::optional<std::filesystem::path> udsPath;
 
-    std::ofstream logFileStream;
+    int logFileFd=-1;
+    int indexFileFd=-1;
+    std::string fileBuffer;
+    std::string indexBuffer;
+    uint64_t fileOffset = 0;    // Size of the log file, buffered bytes included.
+
+    // MMAP storage state.
+    char *segmentMap = nullptr;
+    std::string recordScratch;
+    size_t segmentUsed = 0;
+
+    // Interned formats: offset of the record defining each template in the current log file (zero until
+    // one does), and whether the file is of a version holding templated records at all.
+    std::vector<uint64_t> fileTemplates;
+    bool fileInterning = false;
+    // Writer side: templates looked up so far by id, and the text of the last templated entry.
+    std::vector<const vs_logger::format_template_t*> templateCache;
+    std::string expandedText;
+    uint64_t expandedSeq = 0;
+    std::string templateScratch;
+    uint64_t segmentNumber = 0;     // Current MMAP segment, or last rotated STREAM file.
+    std::chrono::steady_clock::time_point fileOpened;
+
+    // Archiver state, segments waiting to be compressed.
+    std::thread archiverThread;
+    std::mutex archiveMutex;
+    std::condition_variable archiveCv;
+    std::vector<uint64_t> archiveQueue;
+    std::atomic<uint64_t> activeSegment{UINT64_MAX};   // Retention never touches it or newer ones.
+    bool archiveStopping = false;
+    std::chrono::steady_clock::time_point lastFlush;
+    std::chrono::steady_clock::time_point lastSync;
     int udsSock=-1;
-    sockaddr_un udsAddr;
+    struct uds_shard_t {
+        sockaddr_un addr;
+        std::string buffer;
+        std::vector<size_t> datagramEnds;   // End offset in buffer of every closed datagram.
+        std::unique_ptr<vs_logger::shm_ring> ring;              // Set with shm_ring_bytes.
+        std::chrono::steady_clock::time_point announced;        // Last handshake sent for ring.
+        uint64_t announcedTail = 0;                             // What the server had consumed then.
+        std::vector<bool> templates;                            // Templates defined in ring since the last handshake.
+    };
+    std::vector<uds_shard_t> udsShards;
 
     // Sequence number for log entries.
     uint64_t seq_id = 0;
 
     std::mutex writeMutex;
+    // Thread in submit() holding writeMutex, the only one the crash handler takes the outputs over from.
+    std::atomic<std::thread::id> writeOwner;
+
+    // Runtime thresholds as (type << 8 | severity), one load per log() call.
+    std::atomic<uint16_t> minLevel{0};
 
+    config_t config;
+
+    // Raw timestamps of log(), converted by write() under writeMutex or on the writer thread.
+    vs_logger::log_clock clock;
+
+    // Behind metrics(). Shared with the server thread of start_server(), which may outlive the Logger.
+    struct counters_t {
+        std::atomic<uint64_t> entries{0};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<uint64_t> suppressed{0};
+        std::atomic<uint64_t> fileBytes{0};
+        std::atomic<uint64_t> udsBytes{0};
+        std::atomic<uint64_t> udsFailures{0};
+        std::atomic<uint64_t> queueDepth{0};
+        std::atomic<uint64_t> queueHighWater{0};
+        vs_logger::histogram_t flushLatency;
+
+        metrics_t snapshot() const;
+    };
+    std::shared_ptr<counters_t> counters = std::make_shared<counters_t>();
+
+    // Call site limits, from config.
+    bool limiting = false;
+    uint64_t siteInterval = 0;      // Nanoseconds per entry of a site, zero for no rate limit.
+    uint64_t siteTolerance = 0;     // How far ahead of time a burst may go.
+    uint32_t sampleThreshold = 0;   // Kept if a random 32 bit value is below it, UINT32_MAX keeps everything.
+    std::mutex sitesMutex;
+    std::vector<vs_logger::log_site_t*> suppressingSites;   // Sites reporting to this Logger.
+    std::atomic<bool> hasSuppressingSites{false};
+    std::chrono::steady_clock::time_point nextSuppressionReport;
+
+    // ASYNC mode state.
+    bool async = false;
+    const uint64_t instanceId;
+    std::mutex stagingMutex;
+    std::vector<std::shared_ptr<staging_t>> stagingBuffers;
+    std::atomic<uint64_t> stagingGeneration{0};
+    // Writer only: its copy of stagingBuffers, also what crashFlush() drains when the writer is the one
+    // crashing, refreshingBuffers being set while it is reassigned.
+    std::vector<std::shared_ptr<staging_t>> writerBuffers;
+    std::atomic<bool> refreshingBuffers{false};
+    std::vector<merged_t> mergeBatch;
+    size_t mergeWritten = 0;        // Entries of mergeBatch handed to write() so far.
+    std::string mergeArena;
+    std::thread writerThread;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCv;
+    std::atomic<bool> writerIdle{false};
+    // Bumped by the writer after taking records off the queues, and notified if producers wait for room.
+    std::atomic<uint64_t> collections{0};
+    std::atomic<uint32_t> blockedProducers{0};
+    std::atomic<bool> stopping{false};
+    std::atomic<uint64_t> flushRequested{0};
+    std::atomic<uint64_t> flushCompleted{0};
 
     #ifndef LOG_HEADLESS
     // Background thread for the web server.
@@ -79,3 +552,18 @@ private:
     #endif
 };
 
+// Utility functions to convert enum values to strings.
+std::string_view to_string(Logger::type_t type);
+std::string_view to_string(Logger::severity_t sev);
+
+// Log through logger unless the level is below the compile-time thresholds, in which case
+// the call and its arguments compile away. Arguments are those of Logger::log() after the level.
+// Each expansion is a call site for the site_rate and sample_ratio limits of the config.
+#define VS_LOG(logger, type, sev, ...)                                                      \
+    do {                                                                                    \
+        if constexpr (Logger::compiled_in((type), (sev))) {                                 \
+            static constinit vs_logger::log_site_t vs_log_site{__FILE__, __LINE__};         \
+            if ((logger).enabled((type), (sev)) && (logger).admit(vs_log_site, (type), (sev))) \
+                (logger).log((type), (sev), __VA_ARGS__);                                   \
+        }                                                                                   \
+    } while (0)
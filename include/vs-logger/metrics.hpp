@@ -0,0 +1,77 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace vs_logger {
+
+// Latency histogram with power-of-two microsecond buckets, from 1 us to about 4 s, the last bucket
+// catching everything above. Recording is a couple of relaxed atomic increments.
+class histogram_t {
+public:
+    static constexpr size_t bucket_count = 24;
+
+    struct snapshot_t {
+        std::array<uint64_t, bucket_count> counts{};   // Per bucket, not cumulative.
+        uint64_t count = 0;
+        uint64_t sum_ns = 0;
+    };
+
+    // Upper bound of bucket i in microseconds, the last one has none.
+    static constexpr uint64_t bucket_bound_us(size_t i) { return uint64_t(1) << i; }
+
+    void record(std::chrono::nanoseconds value) {
+        uint64_t ns = value.count() > 0 ? (uint64_t)value.count() : 0;
+        uint64_t us = (ns + 999) / 1000;
+        size_t bucket = us <= 1 ? 0 : std::min<size_t>(std::bit_width(us - 1), bucket_count - 1);
+        counts[bucket].fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    snapshot_t snapshot() const {
+        snapshot_t result;
+        for (size_t i = 0; i < bucket_count; i++) {
+            result.counts[i] = counts[i].load(std::memory_order_relaxed);
+            result.count += result.counts[i];
+        }
+        result.sum_ns = sum.load(std::memory_order_relaxed);
+        return result;
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, bucket_count> counts{};
+    std::atomic<uint64_t> sum{0};
+};
+
+// What a Logger did since it was created, see Logger::metrics().
+struct logger_metrics_t {
+    uint64_t entries = 0;              // Entries written to the outputs.
+    uint64_t dropped = 0;              // Entries lost to the overflow policy or to a full shared memory ring.
+    uint64_t suppressed = 0;           // Entries left out by the rate limit or the sampling of VS_LOG call sites.
+    uint64_t file_bytes = 0;           // Bytes of encoded entries written to the log file.
+    uint64_t uds_bytes = 0;            // Bytes sent over UDS, datagrams and shared memory rings.
+    uint64_t uds_send_failures = 0;    // Failed sendmmsg() and ring handshakes.
+    uint64_t queue_depth = 0;          // ASYNC: entries waiting in the staging buffers at the last writer pass.
+    uint64_t queue_high_water = 0;     // ASYNC: largest queue_depth seen.
+    histogram_t::snapshot_t flush_latency;   // Writes of the buffered file contents, fdatasync() included.
+};
+
+// Prometheus text exposition format.
+void prometheus_header(std::string &out, std::string_view name, std::string_view type, std::string_view help);
+// One sample, labels being the text between the braces (e.g. client="3"), or empty.
+void prometheus_sample(std::string &out, std::string_view name, std::string_view labels, uint64_t value);
+// A whole counter or gauge family with a single unlabelled sample.
+void prometheus_metric(std::string &out, std::string_view name, std::string_view type, std::string_view help, uint64_t value);
+// A histogram family in seconds, from a microsecond histogram_t.
+void prometheus_histogram(std::string &out, std::string_view name, std::string_view help, const histogram_t::snapshot_t &histogram);
+
+// Every metric of a Logger, named vs_logger_*.
+void write_prometheus(std::string &out, const logger_metrics_t &metrics);
+
+}
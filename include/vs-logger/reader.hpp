@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "archive.hpp"
+#include "logger.hpp"
+#include "segment.hpp"
+
+// Random access reader for log files (or MMAP segments) written with Logger::format_t::BINARY.
+// Lookups binary search the "<file>.idx" sidecar with pread(), so nothing is loaded in memory
+// and the reader can be used while the Logger is still appending to the same files.
+// Segments compressed after rotation ("<file>.z") are opened transparently when the plain file
+// is gone, and only the blocks holding the requested records are inflated.
+// Templated entries (interned format strings, see vs-logger/templates.hpp) are rendered when they are
+// read, the format string of each template being read once from the record defining it.
+// A reader is not meant to be shared between threads without external locking.
+class LogReader {
+public:
+    explicit LogReader(const std::filesystem::path &logFilePath);
+    ~LogReader();
+
+    // Delete copy semantics.
+    LogReader(const LogReader&) = delete;
+    LogReader& operator=(const LogReader&) = delete;
+
+    bool is_open() const;
+    // Whether path names the file the reader has open: false once it was rotated away, or replaced
+    // by its compressed segment.
+    bool same_file(const std::filesystem::path &path) const;
+
+    // Number of entries in the index.
+    size_t size() const;
+
+    // Index position of the entry with the given sequence number.
+    std::optional<size_t> find_seq(uint64_t seq_id) const;
+    // Index position of the first entry with seq_id >= the given one, size() if there is none.
+    size_t lower_bound_seq(uint64_t seq_id) const;
+    // Index position of the first entry with timestamp >= the given one, size() if there is none.
+    size_t lower_bound(uint64_t timestamp) const;
+
+    // Read the index record at the given position.
+    bool index_at(size_t pos, vs_logger::index_entry_t &out) const;
+    // Read the entry at the given index position, with or without its encoded fields.
+    // False if the record is torn or corrupt: its lengths are not those of its index entry, or it
+    // would end past the end of the file (only this is checked by read_at()).
+    bool read(size_t pos, Logger::log_entry_t &entry, std::string &message) const;
+    bool read(size_t pos, Logger::log_entry_t &entry, std::string &message, std::string &fields) const;
+    // Read the entry whose record starts at the given offset of the log file.
+    bool read_at(uint64_t offset, Logger::log_entry_t &entry, std::string &message) const;
+    bool read_at(uint64_t offset, Logger::log_entry_t &entry, std::string &message, std::string &fields) const;
+
+    // Zero-copy variant of read(): the message points into a read-only shared mapping of the file,
+    // and stays valid for the lifetime of the reader. Not available on compressed segments.
+    // The text of a templated entry is rendered in a buffer instead, valid until the next view().
+    // False if the lengths of the record are not those of its index entry.
+    bool view(size_t pos, Logger::log_entry_t &entry, std::string_view &message) const;
+    bool view(size_t pos, Logger::log_entry_t &entry, std::string_view &message, std::string_view &fields) const;
+
+    // Export the entries in [from, to) using the text log format.
+    void export_text(std::ostream &out, size_t from = 0, size_t to = SIZE_MAX) const;
+
+    // Index the activities of up to max_entries more entries, in log order, returns how many it indexed.
+    // Each entry is only ever visited once, activity() and children() only look up what is indexed.
+    size_t index_activities(size_t max_entries = SIZE_MAX) const;
+    // Index positions of the indexed entries of an activity, in log order.
+    std::vector<size_t> activity(uint64_t activity_uuid) const;
+    // Activities with at least one indexed entry whose parent_uuid is the given one.
+    std::vector<uint64_t> children(uint64_t parent_uuid) const;
+    // Take over the activities indexed by a reader of the same entries, as when its file got compressed.
+    void take_activities(LogReader &other);
+
+private:
+    // pread() on the log file, or on the raw bytes of a compressed segment.
+    bool readRaw(uint64_t offset, void *dst, size_t size) const;
+    // Whether the message and fields of the record at offset end within the file, so that a corrupt
+    // header is not trusted with an allocation.
+    bool fits(const vs_logger::record_header_t &header, uint64_t offset) const;
+
+    // Render the message bytes of a templated record into out.
+    bool expandTemplate(std::string_view raw, std::string &out) const;
+
+    // Templates by offset of the record defining them, and buffers for rendered messages.
+    mutable std::unordered_map<uint64_t, vs_logger::format_template_t> templates;
+    mutable std::string expanded, viewed;
+
+    mutable size_t activitiesIndexed = 0;
+    mutable std::unordered_map<uint64_t, std::vector<size_t>> activityEntries;
+    mutable std::unordered_map<uint64_t, std::set<uint64_t>> activityChildren;
+
+    int logFd = -1;
+    int indexFd = -1;
+    mutable uint64_t knownSize = 0;     // Bytes of the log file as of the last fits() that looked.
+    std::unique_ptr<vs_logger::compressed_segment> compressed;
+
+    // Mappings are only ever added, so views handed out earlier are never invalidated.
+    mutable std::vector<std::pair<const char*, size_t>> maps;
+};
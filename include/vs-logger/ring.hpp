@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace vs_logger {
+
+// Bounded lock-free ring buffer (Vyukov-style, one sequence number per cell).
+// Any number of threads may push and pop concurrently; values are filled and
+// consumed in place, so no copy of T is ever made by the ring itself.
+// With single_producer only one thread may push, which turns the reservation
+// into a plain store. Popping is always safe from several threads.
+template<typename T, bool single_producer = false>
+class bounded_ring {
+public:
+    // Capacity is rounded up to the next power of two.
+    explicit bounded_ring(size_t capacity)
+        : cells(new cell_t[std::bit_ceil(capacity < 2 ? size_t(2) : capacity)]),
+          mask(std::bit_ceil(capacity < 2 ? size_t(2) : capacity) - 1) {
+        for (size_t i = 0; i <= mask; i++)
+            cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    bounded_ring(const bounded_ring&) = delete;
+    bounded_ring& operator=(const bounded_ring&) = delete;
+
+    // Reserve a cell and call fill(T&) on it. Returns false if the ring is full.
+    template<typename F>
+    bool try_push(F&& fill) {
+        cell_t *cell;
+        size_t pos = tail.load(std::memory_order_relaxed);
+        if constexpr (single_producer) {
+            cell = &cells[pos & mask];
+            if (cell->seq.load(std::memory_order_acquire) != pos) return false;
+            tail.store(pos + 1, std::memory_order_relaxed);
+        }
+        else for (;;) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+            if (dif == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (dif < 0) return false;
+            else pos = tail.load(std::memory_order_relaxed);
+        }
+        fill(cell->value);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Take the oldest cell and call consume(T&) on it. Returns false if empty.
+    template<typename F>
+    bool try_pop(F&& consume) {
+        cell_t *cell;
+        size_t pos = head.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (dif == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (dif < 0) return false;
+            else pos = head.load(std::memory_order_relaxed);
+        }
+        consume(cell->value);
+        cell->seq.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Only a hint while producers or consumers are active.
+    bool empty() const {
+        return tail.load(std::memory_order_relaxed) == head.load(std::memory_order_relaxed);
+    }
+
+    size_t size() const {
+        return tail.load(std::memory_order_relaxed) - head.load(std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+private:
+    struct alignas(64) cell_t {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    std::unique_ptr<cell_t[]> cells;
+    const size_t mask;
+
+    // Keep producer and consumer cursors on separate cache lines.
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) std::atomic<size_t> head{0};
+};
+
+}
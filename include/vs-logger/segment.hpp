@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+
+namespace vs_logger {
+
+// On-disk layout of binary log files. All fields use the native byte order of the producer.
+//
+//   log file:   segment_header_t, then for each entry record_header_t + message bytes + encoded fields
+//               (see fields.hpp, older files always have fields_length zero).
+//   index file: one index_entry_t per entry, in the same order as the log file.
+//
+// Version 2 adds templated records, version 1 files are still read and appended to without them.
+
+inline constexpr char segment_magic[8] = {'V', 'S', 'L', 'O', 'G', 'B', 'I', 'N'};
+inline constexpr uint32_t segment_version = 2;
+
+struct segment_header_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_header_size;  // sizeof(record_header_t) used by the writer.
+};
+
+struct record_header_t {
+    uint8_t type;                 // Logger::type_t
+    uint8_t sev;                  // Logger::severity_t, with record_templated.
+    uint16_t fields_length;       // Encoded field bytes following the message.
+    uint32_t length;              // Message bytes following the header.
+    uint64_t timestamp;
+    uint64_t activity_uuid;
+    uint64_t seq_id;
+    uint64_t parent_uuid;
+};
+
+// Set in record_header_t::sev when the message bytes are an interned format (see templates.hpp) instead
+// of the text: a template_ref_t as three varints (see fields.hpp), the format string if format_length
+// is set, then the arguments encoded as fields without keys. The first entry of a template in a log
+// file, or in a shared memory ring, carries its format string, the following ones refer to it.
+inline constexpr uint8_t record_templated = 0x80;
+
+struct template_ref_t {
+    uint64_t id;                  // Id of the template in the producer.
+    uint64_t format_length;       // Format string bytes following, only on the entry defining the template.
+    uint64_t definition;          // Log files: offset of the record defining the template, maybe this one.
+};
+
+struct index_entry_t {
+    uint64_t seq_id;
+    uint64_t timestamp;
+    uint64_t offset;              // Offset of the record_header_t in the log file.
+    uint32_t length;              // Message length.
+    uint32_t fields_length;       // Encoded fields length.
+};
+
+// Compressed segment "<segment>.z": the raw segment bytes cut in blocks of block_size, each one
+// deflated on its own so that a reader only inflates the blocks holding what it looks for.
+// The index of the segment is left uncompressed, and its offsets still refer to the raw bytes.
+//
+//   compressed_header_t, block_count uint64_t end offsets of each block (from the start of the
+//   file), then the blocks.
+inline constexpr char compressed_magic[8] = {'V', 'S', 'L', 'O', 'G', 'Z', 'I', 'P'};
+
+struct compressed_header_t {
+    char magic[8];
+    uint32_t block_size;
+    uint32_t block_count;
+    uint64_t raw_size;
+};
+
+static_assert(sizeof(segment_header_t) == 16);
+static_assert(sizeof(compressed_header_t) == 24);
+static_assert(sizeof(record_header_t) == 40);
+static_assert(sizeof(index_entry_t) == 32);
+
+}
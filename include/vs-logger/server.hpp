@@ -0,0 +1,29 @@
+#pragma once
+
+#ifndef LOG_HEADLESS
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "logger.hpp"
+
+namespace vs_logger {
+
+// Serve the viewer and the "/ws" endpoint on port, forwarding every entry received on the UDS
+// sockets at udsPaths (and their shards). Only the server fields of config are used.
+// When logFilePath names a BINARY log, "/logs" pages through it and its retained segments, and
+// "/activity/<uuid>" also returns the entries stored there. Rotations are followed as they happen.
+// "/metrics" serves counters of the server in Prometheus text format, followed by whatever
+// producerMetrics appends (start_server() passes the metrics of its Logger).
+// Blocks the calling thread for as long as the server runs.
+void run_server(const std::vector<std::filesystem::path>& udsPaths, uint16_t port, const Logger::config_t& config,
+                const std::optional<std::filesystem::path>& logFilePath = std::nullopt,
+                const std::function<void(std::string&)>& producerMetrics = {});
+
+}
+
+#endif
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+#include "segment.hpp"
+
+namespace vs_logger {
+
+// Shared memory ring between one producer (a UDS shard of a Logger) and the server, on the same host.
+// The producer creates a memfd holding shm_header_t and the ring bytes, plus an eventfd used as
+// doorbell, and hands both to the server over its UDS socket. Records are laid out as in a binary
+// log file (record_header_t, then the message and fields bytes), each one padded to 8 bytes. A record never
+// wraps: the space left at the end of the ring is skipped with a record of type shm_skip. An entry larger
+// than max_message() is cut in several records, see record_continued.
+//
+// The producer only rings the doorbell when the server announced it was going to sleep, so a busy
+// server drains the ring without any syscall on either side.
+inline constexpr char shm_magic[8] = {'V', 'S', 'L', 'O', 'G', 'S', 'H', 'M'};
+inline constexpr uint8_t shm_skip = 0xff;
+
+// Set in record_header_t::sev of every fragment of an entry but the last one, which all have its header and
+// seq_id: the message and fields bytes of the fragments are joined back in order. Fragments followed by a
+// record of another seq_id are left over from an entry that did not make it to the ring, and are dropped.
+inline constexpr uint8_t record_continued = 0x40;
+
+// First byte of the handshake datagram, which carries the fds as SCM_RIGHTS. Entries never start with it.
+inline constexpr char shm_handshake = '\0';
+
+struct shm_header_t {
+    char magic[8];
+    uint64_t token;                                // Random, the producer may announce a ring more than once.
+    uint64_t capacity;                             // Ring bytes following the header, a power of two.
+    alignas(64) std::atomic<uint64_t> head;        // Producer: end of the published records.
+    std::atomic<uint64_t> dropped;                 // Producer: entries lost while the ring was full.
+    std::atomic<uint32_t> closed;                  // Producer: nothing will be published anymore.
+    alignas(64) std::atomic<uint64_t> tail;        // Server: end of the consumed records.
+    std::atomic<uint32_t> sleeping;                // Server: waiting on the doorbell.
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free);
+
+class shm_ring {
+public:
+    // Producer side: a new ring of at least capacity bytes. Nullptr on failure.
+    static std::unique_ptr<shm_ring> create(size_t capacity);
+    // Server side: map a ring received from a producer, taking ownership of both fds. Nullptr on failure.
+    static std::unique_ptr<shm_ring> attach(int memfd, int doorbell);
+    ~shm_ring();
+
+    // Delete copy semantics.
+    shm_ring(const shm_ring&) = delete;
+    shm_ring& operator=(const shm_ring&) = delete;
+
+    int memfd() const { return memFd; }
+    int doorbell() const { return doorbellFd; }
+    uint64_t token() const { return header->token; }
+    uint64_t capacity() const { return header->capacity; }
+
+    // Producer: largest message and fields push() can take.
+    size_t max_message() const { return header->capacity / 4; }
+    // Producer: write a record after the unpublished ones, waiting while the server drains a full ring.
+    // False if the server does not make room, the entry is then counted as dropped.
+    bool push(const record_header_t &record, std::string_view message, std::string_view fields = {});
+    // Producer: make the pushed records visible, waking the server if it sleeps.
+    void publish();
+    // Producer: tell the server to detach once it consumed everything.
+    void close();
+
+    // Server: call f(record, message, fields) on every published record, in place, at most max of them.
+    // Returns how many records were consumed.
+    template<typename F>
+    size_t consume(F &&f, size_t max) {
+        uint64_t head = header->head.load(std::memory_order_acquire);
+        uint64_t tail = header->tail.load(std::memory_order_relaxed);
+        size_t count = 0;
+        while (tail != head && count < max) {
+            const auto *record = (const record_header_t*)(data + (tail & mask));
+            if (record->type == shm_skip) {
+                tail += mask + 1 - (tail & mask);
+                continue;
+            }
+            // A record running past the end of the ring can only come from a broken producer.
+            size_t size = sizeof(record_header_t) + record->length + record->fields_length;
+            if ((tail & mask) + size > mask + 1) {
+                tail = head;
+                break;
+            }
+            const char *message = (const char*)(record + 1);
+            f(*record, std::string_view(message, record->length), std::string_view(message + record->length, record->fields_length));
+            tail += padded(size);
+            count++;
+        }
+        header->tail.store(tail, std::memory_order_release);
+        return count;
+    }
+    // Server: announce a wait on the doorbell. False if records were published meanwhile.
+    bool sleep();
+    // Server: reset the doorbell after it fired.
+    void clear_doorbell();
+    bool closed() const { return header->closed.load(std::memory_order_acquire); }
+    bool empty() const { return header->head.load(std::memory_order_acquire) == header->tail.load(std::memory_order_relaxed); }
+    uint64_t consumed() const { return header->tail.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return header->dropped.load(std::memory_order_relaxed); }
+
+private:
+    shm_ring(int memFd, int doorbellFd, shm_header_t *header, size_t mappedSize);
+
+    static constexpr size_t padded(size_t size) { return (size + 7) & ~size_t(7); }
+    static constexpr std::chrono::milliseconds stall_timeout{50};
+
+    bool reserve(uint64_t end);
+
+    int memFd;
+    int doorbellFd;
+    shm_header_t *header;
+    char *data;
+    size_t mappedSize;
+    uint64_t mask;
+
+    // Producer state: end of the pushed records, the last tail seen, and where the server stopped.
+    uint64_t writePos = 0;
+    uint64_t cachedTail = 0;
+    uint64_t stalledTail = 0;
+    bool stalled = false;
+};
+
+}
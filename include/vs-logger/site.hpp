@@ -0,0 +1,23 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace vs_logger {
+
+// State of one VS_LOG call site, a constinit static of the macro expansion, so it costs no guard.
+// Rate limiting is a GCRA token bucket: next is the time the bucket is empty again, one atomic for
+// every thread logging from the site. Entries left out are counted until the Logger owning the site
+// reports them.
+struct log_site_t {
+    constexpr log_site_t(const char *file, unsigned line) : file(file), line(line) {}
+
+    const char *file;
+    unsigned line;
+    std::atomic<uint64_t> next{0};              // Steady clock nanoseconds.
+    std::atomic<uint64_t> suppressed{0};
+    std::atomic<const void*> owner{nullptr};    // Logger which reports the suppressed entries.
+    std::atomic<uint16_t> level{0};             // (type << 8 | severity) of the first suppressed entry.
+};
+
+}
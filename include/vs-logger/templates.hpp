@@ -0,0 +1,66 @@
+#pragma once
+
+#include <concepts>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "segment.hpp"
+
+namespace vs_logger {
+
+// Format strings given to Logger::log(type, sev, activity_uuid, parent_uuid, "format {}", args...) are
+// interned: registered once in a process-wide dictionary which gives them an id. BINARY log files and
+// shared memory rings then carry the id and the arguments, encoded as fields without keys (see
+// fields.hpp), and the text is only rendered where it is read: text outputs, JSON datagrams,
+// LogReader and the server. See template_ref_t in segment.hpp for the record layout.
+
+// Arguments an interned entry can carry and render exactly as std::format would with the original type.
+// Characters and float are left out: once encoded (as an integer, as a double) they would render differently.
+template<typename T>
+concept internable_arg =
+    (std::integral<T> && !std::same_as<T, char> && !std::same_as<T, wchar_t> && !std::same_as<T, char8_t> &&
+     !std::same_as<T, char16_t> && !std::same_as<T, char32_t>) ||
+    std::same_as<T, double> ||
+    (!std::is_arithmetic_v<T> && std::convertible_to<const T&, std::string_view>);
+
+// A parsed format string, rendering encoded arguments.
+class format_template_t {
+public:
+    // Nullopt for what expand() does not handle: nested replacement fields ("{:{}}"), mixed manual and
+    // automatic argument indexing, unbalanced braces.
+    static std::optional<format_template_t> parse(std::string_view format);
+
+    std::string_view format() const { return text; }
+    // Append the text rendered from the encoded arguments. False if they do not match the format, the
+    // fields which could not be rendered are then left as "{?}".
+    bool expand(std::string &out, std::string_view args) const;
+
+private:
+    struct segment_t {
+        std::string literal;          // Text before the replacement field, escaped braces resolved.
+        int arg = -1;                 // Argument of the replacement field, -1 after the last one.
+        std::string spec;             // "{:<spec>}" for std::vformat(), empty for a plain "{}".
+    };
+
+    std::string text;
+    std::vector<segment_t> segments;
+};
+
+// template_ref_t as written in templated records, at most max_ref_bytes.
+inline constexpr size_t max_ref_bytes = 30;
+char *encode_ref(char *dst, const template_ref_t &ref);
+// Decode the reference at the start of bytes, removing it from them. False if it is cut short.
+bool decode_ref(std::string_view &bytes, template_ref_t &ref);
+
+// Id of format in the process-wide dictionary (from 1), or 0 if it cannot be interned. Ids are cached per
+// thread by address of the format string, and checked against its text, so a call site only takes the
+// dictionary lock the first time.
+uint32_t intern_format(std::string_view format);
+// Template of an id returned by intern_format(), nullptr if there is none. Takes the dictionary lock.
+const format_template_t *interned_format(uint32_t id);
+
+}
@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <iostream>
+#include <unistd.h>
+#include <fcntl.h>
+#include <zlib.h>
+
+#include "vs-logger/archive.hpp"
+
+static bool writeAllAt(int fd, const char *data, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t ret = pwrite(fd, data, size, offset);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += ret;
+        size -= ret;
+        offset += ret;
+    }
+    return true;
+}
+
+std::filesystem::path vs_logger::segment_path(const std::filesystem::path &path, uint64_t n) {
+    auto result = path;
+    result += "." + std::to_string(n);
+    return result;
+}
+
+std::vector<std::pair<uint64_t, bool>> vs_logger::list_segments(const std::filesystem::path &path) {
+    std::vector<std::pair<uint64_t, bool>> segments;
+    std::error_code ec;
+    auto prefix = path.filename().string() + ".";
+    for (auto &item : std::filesystem::directory_iterator(path.parent_path().empty() ? "." : path.parent_path(), ec)) {
+        auto name = item.path().filename().string();
+        if (!name.starts_with(prefix) || name.size() == prefix.size()) continue;
+        auto suffix = std::string_view(name).substr(prefix.size());
+        bool compressed = suffix.ends_with(".z");
+        if (compressed) suffix.remove_suffix(2);
+        if (suffix.empty() || suffix.find_first_not_of("0123456789") != std::string_view::npos) continue;
+        segments.emplace_back(std::stoull(std::string(suffix)), compressed);
+    }
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+bool vs_logger::compress_segment(const std::filesystem::path &path, size_t block_size) {
+    int in = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        std::cerr << "Failed to open log segment: " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    uint64_t rawSize = lseek(in, 0, SEEK_END);
+
+    auto tmpPath = path;
+    tmpPath += ".z.tmp";
+    int out = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0) {
+        std::cerr << "Failed to create compressed segment: " << tmpPath << ": " << strerror(errno) << std::endl;
+        close(in);
+        return false;
+    }
+
+    compressed_header_t header{};
+    memcpy(header.magic, compressed_magic, sizeof(header.magic));
+    header.block_size = (uint32_t)block_size;
+    header.block_count = (uint32_t)((rawSize + block_size - 1) / block_size);
+    header.raw_size = rawSize;
+
+    // Blocks go after the header and the table, which is only written once all the sizes are known.
+    std::vector<uint64_t> blockEnds(header.block_count);
+    uint64_t end = sizeof(header) + blockEnds.size() * sizeof(uint64_t);
+    std::string raw(block_size, '\0');
+    std::string packed(compressBound(block_size), '\0');
+    bool ok = true;
+    for (uint32_t i = 0; ok && i < header.block_count; i++) {
+        size_t size = std::min<uint64_t>(block_size, rawSize - (uint64_t)i * block_size);
+        uLongf packedSize = packed.size();
+        ok = pread(in, raw.data(), size, (off_t)i * block_size) == (ssize_t)size &&
+             compress2((Bytef*)packed.data(), &packedSize, (const Bytef*)raw.data(), size, Z_DEFAULT_COMPRESSION) == Z_OK &&
+             writeAllAt(out, packed.data(), packedSize, end);
+        end += packedSize;
+        blockEnds[i] = end;
+    }
+    ok = ok && writeAllAt(out, (const char*)&header, sizeof(header), 0) &&
+         writeAllAt(out, (const char*)blockEnds.data(), blockEnds.size() * sizeof(uint64_t), sizeof(header)) &&
+         fdatasync(out) == 0;
+    close(in);
+    close(out);
+
+    auto finalPath = path;
+    finalPath += ".z";
+    if (!ok || rename(tmpPath.c_str(), finalPath.c_str()) < 0) {
+        std::cerr << "Failed to compress log segment: " << path << ": " << strerror(errno) << std::endl;
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    unlink(path.c_str());
+    return true;
+}
+
+vs_logger::compressed_segment::compressed_segment(int fd) : fd(fd) {
+    if (fd < 0) return;
+    if (pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+        memcmp(header.magic, compressed_magic, sizeof(header.magic)) != 0 || header.block_size == 0) {
+        std::cerr << "Not a compressed log segment" << std::endl;
+        close(fd);
+        this->fd = -1;
+        return;
+    }
+    blockEnds.resize(header.block_count);
+    ssize_t tableSize = blockEnds.size() * sizeof(uint64_t);
+    if (pread(fd, blockEnds.data(), tableSize, sizeof(header)) != tableSize) {
+        std::cerr << "Truncated compressed log segment" << std::endl;
+        close(fd);
+        this->fd = -1;
+    }
+}
+
+vs_logger::compressed_segment::~compressed_segment() {
+    if (fd >= 0) close(fd);
+}
+
+bool vs_logger::compressed_segment::load(uint32_t block) const {
+    if (block == cachedBlock) return true;
+    if (block >= header.block_count) return false;
+
+    uint64_t begin = block == 0 ? sizeof(header) + blockEnds.size() * sizeof(uint64_t) : blockEnds[block - 1];
+    size_t packedSize = blockEnds[block] - begin;
+    packed.resize(packedSize);
+    if (pread(fd, packed.data(), packedSize, begin) != (ssize_t)packedSize) return false;
+
+    uLongf size = std::min<uint64_t>(header.block_size, header.raw_size - (uint64_t)block * header.block_size);
+    cache.resize(size);
+    if (uncompress((Bytef*)cache.data(), &size, (const Bytef*)packed.data(), packedSize) != Z_OK) {
+        cachedBlock = UINT32_MAX;
+        return false;
+    }
+    cachedBlock = block;
+    return true;
+}
+
+bool vs_logger::compressed_segment::read(uint64_t offset, void *dst, size_t n) const {
+    if (offset + n > header.raw_size) return false;
+    char *out = (char*)dst;
+    while (n > 0) {
+        uint32_t block = offset / header.block_size;
+        if (!load(block)) return false;
+        size_t start = offset - (uint64_t)block * header.block_size;
+        size_t count = std::min(n, cache.size() - start);
+        memcpy(out, cache.data() + start, count);
+        out += count;
+        offset += count;
+        n -= count;
+    }
+    return true;
+}
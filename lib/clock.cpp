@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#include "vs-logger/clock.hpp"
+
+// Only a counter running at a constant rate whatever the power state can be fitted to the wall clock.
+static bool invariantCounter() {
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned a, b, c, d;
+    return __get_cpuid(0x80000007, &a, &b, &c, &d) && (d & (1u << 8));
+#elif defined(__aarch64__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+vs_logger::log_clock::log_clock(clock_source_t source, std::chrono::milliseconds calibration_interval)
+    : clockSource(source), interval(calibration_interval) {
+    if (clockSource == clock_source_t::TSC && !invariantCounter()) {
+        std::cerr << "Logger: No invariant TSC, using the steady clock instead" << std::endl;
+        clockSource = clock_source_t::STEADY;
+    }
+    origin = anchor = sample();
+    if (clockSource == clock_source_t::TSC) {
+#if defined(__aarch64__)
+        uint64_t frequency;
+        asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+        nsPerTick = 1e9 / (double)frequency;
+#else
+        // A first estimate of the rate, every calibration refines it over a longer span.
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        anchor = sample();
+        nsPerTick = (double)(anchor.mono - origin.mono) / (double)(anchor.raw - origin.raw);
+#endif
+    }
+    nextCalibration = anchor.raw + (uint64_t)((double)interval.count() / nsPerTick);
+}
+
+vs_logger::log_clock::sample_t vs_logger::log_clock::sample() const {
+    // Keep the tightest of a few tries, the raw reading is the middle of the window.
+    sample_t best{};
+    uint64_t bestWindow = UINT64_MAX;
+    for (int i = 0; i < 3; i++) {
+        uint64_t before = now();
+        uint64_t mono = read(CLOCK_MONOTONIC);
+        uint64_t real = read(CLOCK_REALTIME);
+        uint64_t after = now();
+        if (after - before < bestWindow) {
+            bestWindow = after - before;
+            best = {before + (after - before) / 2, mono, real};
+        }
+    }
+    return best;
+}
+
+void vs_logger::log_clock::reanchor(uint64_t floor) {
+    auto current = sample();
+    int64_t previous = std::max(wall_ns(current.raw), (int64_t)floor);
+    // The monotonic clock is slewed but never stepped, so it gives the rate; the real time only the offset.
+    if (clockSource == clock_source_t::TSC && current.raw > origin.raw && current.mono > origin.mono)
+        nsPerTick = (double)(current.mono - origin.mono) / (double)(current.raw - origin.raw);
+    anchor = current;
+    // Following a step back of the real time would go back in time: start ahead of it instead.
+    ahead = std::max<int64_t>(previous - (int64_t)anchor.real, 0);
+    nextCalibration = anchor.raw + (uint64_t)((double)interval.count() / nsPerTick);
+}
+
+void vs_logger::log_clock::resume(uint64_t wall) {
+    reanchor(wall * 1000);
+    lastWall = std::max(lastWall, wall);
+}
+
+uint64_t vs_logger::log_clock::to_wall(uint64_t raw) {
+    if (raw >= nextCalibration) calibrate();
+    lastWall = wall_of(raw);
+    return lastWall;
+}
+
+int64_t vs_logger::log_clock::wall_ns(uint64_t raw) const {
+    // Readings older than the anchor (entries merged late) are converted backwards from it.
+    int64_t elapsed = std::llround((double)(int64_t)(raw - anchor.raw) * nsPerTick);
+    int64_t lead = ahead;
+    if (lead > 0 && elapsed > 0) lead = std::max<int64_t>(lead - std::llround((double)elapsed * slew_rate), 0);
+    return (int64_t)anchor.real + elapsed + lead;
+}
+
+uint64_t vs_logger::log_clock::wall_of(uint64_t raw) const {
+    uint64_t wall = (uint64_t)std::max<int64_t>(wall_ns(raw), 0) / 1000;
+    return wall > lastWall ? wall : lastWall;
+}
@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+#include "vs-logger/fields.hpp"
+#include "vs-logger/json.hpp"
+
+static uint64_t zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+// Encoded size of one field, with its key cut to what its length byte can hold.
+static size_t fieldSize(const vs_logger::field_t &field) {
+    size_t size = 2 + std::min<size_t>(field.key.size(), 255);
+    switch (field.kind) {
+        case vs_logger::field_kind_t::INT:    return size + vs_logger::varint_size(zigzag(field.i));
+        case vs_logger::field_kind_t::UINT:   return size + vs_logger::varint_size(field.u);
+        case vs_logger::field_kind_t::BOOL:   return size + 1;
+        case vs_logger::field_kind_t::UUID:   return size + 16;
+        case vs_logger::field_kind_t::STRING: return size + vs_logger::varint_size(field.text.size()) + field.text.size();
+        default:                              return size + 8;
+    }
+}
+
+size_t vs_logger::encoded_fields_size(fields_t fields) {
+    size_t total = 0;
+    for (const auto &field : fields) {
+        size_t size = fieldSize(field);
+        if (total + size <= max_fields_bytes) total += size;
+    }
+    return total;
+}
+
+bool vs_logger::fields_fit(fields_t fields) {
+    size_t total = 0;
+    for (const auto &field : fields) total += fieldSize(field);
+    return total <= max_fields_bytes;
+}
+
+char *vs_logger::encode_fields(char *dst, fields_t fields) {
+    size_t total = 0;
+    for (const auto &field : fields) {
+        size_t size = fieldSize(field);
+        // Same choice as encoded_fields_size(): a field which does not fit is skipped.
+        if (total + size > max_fields_bytes) continue;
+        total += size;
+
+        size_t keyLength = std::min<size_t>(field.key.size(), 255);
+        *dst++ = (char)field.kind;
+        *dst++ = (char)keyLength;
+        memcpy(dst, field.key.data(), keyLength);
+        dst += keyLength;
+        switch (field.kind) {
+            case field_kind_t::INT:
+                dst = put_varint(dst, zigzag(field.i));
+                break;
+            case field_kind_t::UINT:
+                dst = put_varint(dst, field.u);
+                break;
+            case field_kind_t::BOOL:
+                *dst++ = field.b;
+                break;
+            case field_kind_t::UUID:
+                memcpy(dst, &field.uuid, 16);
+                dst += 16;
+                break;
+            case field_kind_t::STRING:
+                dst = put_varint(dst, field.text.size());
+                memcpy(dst, field.text.data(), field.text.size());
+                dst += field.text.size();
+                break;
+            default:
+                memcpy(dst, &field.d, 8);
+                dst += 8;
+        }
+    }
+    return dst;
+}
+
+void vs_logger::field_json(std::string &out, const field_t &field) {
+    char scratch[40];
+    switch (field.kind) {
+        case field_kind_t::INT:
+            out.append(scratch, std::to_chars(scratch, scratch + sizeof(scratch), field.i).ptr);
+            break;
+        case field_kind_t::UINT:
+            out.append(scratch, std::to_chars(scratch, scratch + sizeof(scratch), field.u).ptr);
+            break;
+        case field_kind_t::DOUBLE:
+            // JSON has no infinities nor NaN.
+            if (std::isfinite(field.d)) out.append(scratch, std::to_chars(scratch, scratch + sizeof(scratch), field.d).ptr);
+            else out += "null";
+            break;
+        case field_kind_t::BOOL:
+            out += field.b ? "true" : "false";
+            break;
+        case field_kind_t::UUID: {
+            static constexpr char hex[] = "0123456789abcdef";
+            char *p = scratch;
+            *p++ = '"';
+            for (int i = 0; i < 32; i++) {
+                if (i == 8 || i == 12 || i == 16 || i == 20) *p++ = '-';
+                uint64_t half = i < 16 ? field.uuid.high : field.uuid.low;
+                *p++ = hex[(half >> (60 - 4 * (i % 16))) & 0xf];
+            }
+            *p++ = '"';
+            out.append(scratch, p);
+            break;
+        }
+        case field_kind_t::STRING:
+            out += '"';
+            escape_json(out, field.text);
+            out += '"';
+            break;
+    }
+}
+
+void vs_logger::fields_json(std::string &out, std::string_view encoded) {
+    out += '{';
+    bool first = true;
+    for_each_field(encoded, [&](const field_t &field) {
+        if (!first) out += ',';
+        first = false;
+        out += '"';
+        escape_json(out, field.key);
+        out += "\":";
+        field_json(out, field);
+    });
+    out += '}';
+}
+
+void vs_logger::fields_text(std::string &out, std::string_view encoded) {
+    for_each_field(encoded, [&](const field_t &field) {
+        out += ' ';
+        out += field.key;
+        out += '=';
+        // Strings are quoted and escaped like in JSON, so a line stays a line.
+        field_json(out, field);
+    });
+}
@@ -0,0 +1,162 @@
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VS_LOGGER_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define VS_LOGGER_NEON 1
+#endif
+
+#include "vs-logger/json.hpp"
+
+namespace vs_logger {
+
+static inline bool needs_escape(unsigned char c) {
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+// Write the escape sequence for a byte which needs_escape().
+static inline char *escape_byte(char *dst, unsigned char c) {
+    static constexpr char hex[] = "0123456789abcdef";
+    *dst++ = '\\';
+    switch (c) {
+        case '"':  *dst++ = '"';  break;
+        case '\\': *dst++ = '\\'; break;
+        case '\b': *dst++ = 'b';  break;
+        case '\f': *dst++ = 'f';  break;
+        case '\n': *dst++ = 'n';  break;
+        case '\r': *dst++ = 'r';  break;
+        case '\t': *dst++ = 't';  break;
+        default:
+            memcpy(dst, "u00", 3);
+            dst[3] = hex[c >> 4];
+            dst[4] = hex[c & 0xf];
+            dst += 5;
+    }
+    return dst;
+}
+
+// Scalar loop for the tail (and for the whole input on the fallback path).
+static inline char *escape_tail(char *dst, const char *src, const char *end) {
+    while (src < end) {
+        const char *run = src;
+        while (src < end && !needs_escape((unsigned char)*src)) src++;
+        memcpy(dst, run, src - run);
+        dst += src - run;
+        if (src < end) dst = escape_byte(dst, (unsigned char)*src++);
+    }
+    return dst;
+}
+
+size_t escape_json_scalar(char *dst, std::string_view s) {
+    return escape_tail(dst, s.data(), s.data() + s.size()) - dst;
+}
+
+#ifdef VS_LOGGER_X86
+
+__attribute__((target("sse2")))
+static size_t escape_json_sse2(char *dst, std::string_view s) {
+    char *out = dst;
+    const char *src = s.data(), *end = s.data() + s.size();
+    const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\'), control = _mm_set1_epi8(0x1f);
+
+    while (end - src >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)src);
+        // v <= 0x1f (unsigned) is the same as max(v, 0x1f) == 0x1f.
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                                   _mm_cmpeq_epi8(_mm_max_epu8(v, control), control));
+        unsigned mask = _mm_movemask_epi8(hit);
+        if (mask == 0) {
+            _mm_storeu_si128((__m128i*)out, v);
+            src += 16;
+            out += 16;
+            continue;
+        }
+        unsigned clean = __builtin_ctz(mask);
+        memcpy(out, src, clean);
+        out = escape_byte(out + clean, (unsigned char)src[clean]);
+        src += clean + 1;
+    }
+    return escape_tail(out, src, end) - dst;
+}
+
+__attribute__((target("avx2")))
+static size_t escape_json_avx2(char *dst, std::string_view s) {
+    char *out = dst;
+    const char *src = s.data(), *end = s.data() + s.size();
+    const __m256i quote = _mm256_set1_epi8('"'), backslash = _mm256_set1_epi8('\\'), control = _mm256_set1_epi8(0x1f);
+
+    while (end - src >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)src);
+        __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)),
+                                      _mm256_cmpeq_epi8(_mm256_max_epu8(v, control), control));
+        unsigned mask = _mm256_movemask_epi8(hit);
+        if (mask == 0) {
+            _mm256_storeu_si256((__m256i*)out, v);
+            src += 32;
+            out += 32;
+            continue;
+        }
+        unsigned clean = __builtin_ctz(mask);
+        memcpy(out, src, clean);
+        out = escape_byte(out + clean, (unsigned char)src[clean]);
+        src += clean + 1;
+    }
+    return escape_json_sse2(out, std::string_view(src, end - src)) + (out - dst);
+}
+
+#endif
+
+#ifdef VS_LOGGER_NEON
+
+static size_t escape_json_neon(char *dst, std::string_view s) {
+    char *out = dst;
+    const char *src = s.data(), *end = s.data() + s.size();
+    const uint8x16_t quote = vdupq_n_u8('"'), backslash = vdupq_n_u8('\\'), control = vdupq_n_u8(0x20);
+
+    while (end - src >= 16) {
+        uint8x16_t v = vld1q_u8((const uint8_t*)src);
+        uint8x16_t hit = vorrq_u8(vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, backslash)), vcltq_u8(v, control));
+        if (vmaxvq_u8(hit) == 0) {
+            vst1q_u8((uint8_t*)out, v);
+            src += 16;
+            out += 16;
+            continue;
+        }
+        // No movemask on NEON: the chunk is known dirty, finish it with the scalar loop.
+        out = escape_tail(out, src, src + 16);
+        src += 16;
+    }
+    return escape_tail(out, src, end) - dst;
+}
+
+#endif
+
+using escape_fn = size_t (*)(char*, std::string_view);
+
+static escape_fn select_escape() {
+#if defined(VS_LOGGER_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return escape_json_avx2;
+    if (__builtin_cpu_supports("sse2")) return escape_json_sse2;
+#elif defined(VS_LOGGER_NEON)
+    return escape_json_neon;
+#endif
+    return escape_json_scalar;
+}
+
+size_t escape_json(char *dst, std::string_view s) {
+    static const escape_fn impl = select_escape();
+    return impl(dst, s);
+}
+
+void escape_json(std::string &out, std::string_view s) {
+    size_t size = out.size();
+    out.resize_and_overwrite(size + escaped_json_capacity(s.size()), [&](char *data, size_t) {
+        return size + escape_json(data + size, s);
+    });
+}
+
+}
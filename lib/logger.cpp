@@ -1,49 +1,150 @@
 
+#include <algorithm>
+#include <array>
+#include <charconv>
 #include <chrono>
+#include <csignal>
+#include <ctime>
+#include <format>
 #include <iostream>
+#include <limits>
 #include <sstream>
 #include <cstring>
 #include <unistd.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
 #include <sys/un.h>
 
+#include "vs-logger/archive.hpp"
+#include "vs-logger/json.hpp"
 #include "vs-logger/logger.hpp"
+#include "vs-logger/segment.hpp"
 
-#ifndef LOG_HEADLESS
-#include "vs-logger/crow_all.h"
-#endif
+// Entry metadata is rendered from literal fragments built at compile time for every type and severity,
+// around integers written with std::to_chars. Out of range values (a corrupted file) map to "UNKNOWN".
+namespace {
+
+constexpr std::string_view typeNames[] = {"OK", "INFO", "WARNING", "ERROR", "PANIC", "UNKNOWN"};
+constexpr std::string_view severityNames[] = {"NONE", "LOW", "MID", "HIGH", "UNKNOWN"};
+
+constexpr size_t typeIndex(Logger::type_t type) { return std::min<size_t>((size_t)type, std::size(typeNames) - 1); }
+constexpr size_t severityIndex(Logger::severity_t sev) { return std::min<size_t>((size_t)sev, std::size(severityNames) - 1); }
+
+struct fragment_t {
+    char data[64];
+    size_t size;
+
+    constexpr std::string_view view() const { return {data, size}; }
+};
+
+constexpr fragment_t concat(std::initializer_list<std::string_view> parts) {
+    fragment_t fragment{};
+    for (auto part : parts)
+        for (char c : part) fragment.data[fragment.size++] = c;
+    return fragment;
+}
+
+template<typename F>
+constexpr auto fragmentTable(F &&make) {
+    std::array<std::array<fragment_t, std::size(severityNames)>, std::size(typeNames)> table{};
+    for (size_t type = 0; type < std::size(typeNames); type++)
+        for (size_t sev = 0; sev < std::size(severityNames); sev++)
+            table[type][sev] = make(typeNames[type], severityNames[sev]);
+    return table;
+}
+
+// Text: "[TYPE], {SEVERITY}, Activity: <uuid> Seq: <seq> Parent: <parent> -- <message>\n"
+constexpr auto textHeads = fragmentTable([](std::string_view type, std::string_view sev) {
+    return concat({"[", type, "], {", sev, "}, Activity: "});
+});
+constexpr std::string_view textSeq = " Seq: ";
+constexpr std::string_view textParent = " Parent: ";
+constexpr std::string_view textMessage = " -- ";
+
+// JSON: {"timestamp":<ts>,"type":"TYPE","severity":"SEVERITY","activity_uuid":"<uuid>","seq_id":<seq>,
+// "parent_uuid":"<parent>","message":"<escaped message>"}\n
+constexpr std::string_view jsonTimestamp = "{\"timestamp\":";
+constexpr auto jsonHeads = fragmentTable([](std::string_view type, std::string_view sev) {
+    return concat({",\"type\":\"", type, "\",\"severity\":\"", sev, "\",\"activity_uuid\":\""});
+});
+constexpr std::string_view jsonSeq = "\",\"seq_id\":";
+constexpr std::string_view jsonParent = ",\"parent_uuid\":\"";
+constexpr std::string_view jsonMessage = "\",\"message\":\"";
+constexpr std::string_view jsonEnd = "\"}\n";
+// With fields: ...,"parent_uuid":"<parent>","fields":{...},"message":"<escaped message>"}\n
+constexpr std::string_view jsonFields = "\",\"fields\":";
+constexpr std::string_view jsonFieldsMessage = ",\"message\":\"";
+
+constexpr size_t maxDigits = std::numeric_limits<uint64_t>::digits10 + 1;
+// Longest rendering of the text metadata, up to the " -- " before the message.
+constexpr size_t textHeadBound = sizeof(fragment_t::data) + textSeq.size() + textParent.size() + textMessage.size() +
+                                 3 * maxDigits;
+// Longest rendering of the JSON metadata, up to the parent_uuid digits.
+constexpr size_t jsonHeadBound = jsonTimestamp.size() + sizeof(fragment_t::data) + jsonSeq.size() + jsonParent.size() +
+                                 4 * maxDigits;
+
+char *putLiteral(char *out, std::string_view literal) {
+    memcpy(out, literal.data(), literal.size());
+    return out + literal.size();
+}
+
+char *putInteger(char *out, uint64_t value) {
+    return std::to_chars(out, out + maxDigits, value).ptr;
+}
+
+}
 
-// Utility functions to convert enum values to strings.
 std::string_view to_string(Logger::type_t type) {
-    switch (type) {
-        case Logger::type_t::OK:      return "OK";
-        case Logger::type_t::INFO:    return "INFO";
-        case Logger::type_t::WARNING: return "WARNING";
-        case Logger::type_t::ERROR:   return "ERROR";
-        case Logger::type_t::PANIC:   return "PANIC";
-    }
-    return "UNKNOWN";
+    return typeNames[typeIndex(type)];
 }
 
 std::string_view to_string(Logger::severity_t sev) {
-    switch (sev) {
-        case Logger::severity_t::NONE: return "NONE";
-        case Logger::severity_t::LOW:  return "LOW";
-        case Logger::severity_t::MID:  return "MID";
-        case Logger::severity_t::HIGH: return "HIGH";
-    }
-    return "UNKNOWN";
+    return severityNames[severityIndex(sev)];
 }
 
 Logger::Logger(std::optional<std::filesystem::path> logFilePath, std::optional<std::filesystem::path> udsPath)
-    : logFilePath(logFilePath), udsPath(udsPath) {
+    : Logger(logFilePath, udsPath, config_t{}) {}
+
+static vs_logger::record_header_t makeRecord(const Logger::log_entry_t &entry, size_t length, size_t fieldsLength) {
+    vs_logger::record_header_t header{};
+    header.type = (uint8_t)entry.type;
+    header.sev = (uint8_t)entry.sev;
+    header.fields_length = (uint16_t)fieldsLength;
+    header.length = (uint32_t)length;
+    header.timestamp = entry.timestamp;
+    header.activity_uuid = entry.activity_uuid;
+    header.seq_id = entry.seq_id;
+    header.parent_uuid = entry.parent_uuid;
+    return header;
+}
+
+// Thread-local staging buffers are keyed by this id, so a new Logger at a reused address never aliases a dead one.
+static std::atomic<uint64_t> nextInstanceId{1};
+
+// Loggers with crash_handler, in fixed slots the signal handler can walk, and the handlers it replaced.
+static constexpr int crashSignals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+static struct sigaction previousActions[std::size(crashSignals)];
+static std::atomic<Logger*> crashLoggers[8];
+
+Logger::Logger(std::optional<std::filesystem::path> logFilePath, std::optional<std::filesystem::path> udsPath,
+               const config_t &config)
+    : logFilePath(logFilePath), udsPath(udsPath), config(config), clock(config.clock_source, config.clock_calibration),
+      instanceId(nextInstanceId.fetch_add(1)) {
     if(logFilePath.has_value()){
         auto& path = *logFilePath;
-        // Open the log file (located in tmpfs under /tmp).
-        logFileStream.open(path, std::ios::app);
-        if (!logFileStream.is_open()) {
-            std::cerr << "Failed to open log file: " << path << std::endl;
+        openLogFile(path);
+        fileBuffer.reserve(config.flush_bytes);
+        lastFlush = lastSync = std::chrono::steady_clock::now();
+
+        if (config.compress_segments || config.retain_segments > 0) {
+            // Pick up segments left uncompressed by a previous run.
+            for (auto [n, compressed] : vs_logger::list_segments(path))
+                if (!compressed && n < activeSegment.load()) archiveQueue.push_back(n);
+            archiverThread = std::thread([this]() { archiverLoop(); });
         }
     }
 
@@ -54,660 +155,1292 @@ Logger::Logger(std::optional<std::filesystem::path> logFilePath, std::optional<s
             std::cerr << "notifySubscribers: Failed to create socket: " << strerror(errno) << std::endl;
             return;
         }
+        // Autobind to a unique abstract address: the server tells producers apart by it when it joins
+        // the fragments of large entries.
+        sa_family_t family = AF_UNIX;
+        if (bind(udsSock, (struct sockaddr*)&family, sizeof(family)) < 0)
+            std::cerr << "notifySubscribers: Failed to bind socket: " << strerror(errno) << std::endl;
+
+        // Use the same addresses as the UDS listeners (web server bridge).
+        udsShards.resize(std::max(config.uds_shards, 1u));
+        for (unsigned i = 0; i < udsShards.size(); i++) {
+            auto &addr = udsShards[i].addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            strncpy(addr.sun_path, uds_shard_path(*udsPath, i).c_str(), sizeof(addr.sun_path) - 1);
+            if (config.shm_ring_bytes > 0) {
+                udsShards[i].ring = vs_logger::shm_ring::create(config.shm_ring_bytes);
+                if (udsShards[i].ring) announceRing(udsShards[i]);
+            }
+        }
+    }
+
+    if (config.site_rate > 0) {
+        siteInterval = std::max<uint64_t>((uint64_t)(1e9 / config.site_rate), 1);
+        siteTolerance = siteInterval * (std::max(config.site_burst, 1u) - 1);
+    }
+    sampleThreshold = config.sample_ratio >= 1.0 ? UINT32_MAX
+                                                 : (uint32_t)(std::max(config.sample_ratio, 0.0) * UINT32_MAX);
+    limiting = siteInterval > 0 || sampleThreshold < UINT32_MAX;
+    nextSuppressionReport = std::chrono::steady_clock::now() + config.suppression_interval;
+
+    if (config.mode == mode_t::ASYNC) {
+        async = true;
+        writerThread = std::thread([this]() { writerLoop(); });
+    }
+
+    if (config.crash_handler) {
+        bool registered = false;
+        for (auto &slot : crashLoggers) {
+            Logger *empty = nullptr;
+            if (slot.compare_exchange_strong(empty, this)) {
+                registered = true;
+                break;
+            }
+        }
+        if (!registered) std::cerr << "Too many Loggers with crash_handler, not handling crashes for this one" << std::endl;
 
-        memset(&udsAddr, 0, sizeof(udsAddr));
-        udsAddr.sun_family = AF_UNIX;
-        // Use the same address as the UDS listener (web server bridge).
-        strncpy(udsAddr.sun_path, udsPath->c_str(), sizeof(udsAddr.sun_path) - 1);
+        static std::once_flag installed;
+        std::call_once(installed, []() {
+            for (size_t i = 0; i < std::size(crashSignals); i++) {
+                struct sigaction action{};
+                action.sa_handler = crashSignal;
+                sigemptyset(&action.sa_mask);
+                // Stack overflows can only be handled on an alternate stack, if the application set one up.
+                action.sa_flags = SA_ONSTACK;
+                if (sigaction(crashSignals[i], &action, &previousActions[i]) < 0)
+                    std::cerr << "Failed to install crash handler: " << strerror(errno) << std::endl;
+            }
+        });
     }
 }
 
 Logger::~Logger() {
-    if (logFileStream.is_open())
-        logFileStream.close();
+    for (auto &slot : crashLoggers) {
+        Logger *self = this;
+        slot.compare_exchange_strong(self, nullptr);
+    }
+
+    if (writerThread.joinable()) {
+        // Let the writer drain whatever is still queued before closing the outputs.
+        stopping.store(true);
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            wakeCv.notify_one();
+        }
+        writerThread.join();
+
+        std::lock_guard<std::mutex> lock(stagingMutex);
+        for (auto &buffer : stagingBuffers)
+            buffer->detached.store(true, std::memory_order_release);
+    }
+
+    // The writer is gone, what the call sites left out since the last report goes out now.
+    {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        if (reportSuppressed(true) && udsSock >= 0) flushWS();
+        std::lock_guard<std::mutex> sitesLock(sitesMutex);
+        for (auto *site : suppressingSites) site->owner.store(nullptr, std::memory_order_release);
+    }
+
+    if (archiverThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(archiveMutex);
+            archiveStopping = true;
+            archiveCv.notify_one();
+        }
+        archiverThread.join();
+    }
+
+    if (segmentMap)
+        closeSegment();
+    if (logFileFd >= 0) {
+        flushFile();
+        close(logFileFd);
+    }
+    if (indexFileFd >= 0)
+        close(indexFileFd);
     
+    // The server detaches each ring once it drained it.
+    for (auto &shard : udsShards) {
+        if (shard.ring) shard.ring->close();
+    }
     if (udsSock>=0)
         close(udsSock);
 }
 
-uint64_t Logger::getTimestamp() {
-    using namespace std::chrono;
-    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+// Write the whole buffer, retrying on partial writes and signals.
+static bool writeAll(int fd, const char *data, size_t size) {
+    size_t written = 0;
+    while (written < size) {
+        ssize_t ret = ::write(fd, data + written, size - written);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        written += ret;
+    }
+    return true;
+}
+
+static void fillSegmentHeader(vs_logger::segment_header_t &header) {
+    memcpy(header.magic, vs_logger::segment_magic, sizeof(header.magic));
+    header.version = vs_logger::segment_version;
+    header.record_header_size = sizeof(vs_logger::record_header_t);
+}
+
+static bool checkSegmentHeader(const vs_logger::segment_header_t &header) {
+    return memcmp(header.magic, vs_logger::segment_magic, sizeof(header.magic)) == 0 &&
+           header.version >= 1 && header.version <= vs_logger::segment_version &&
+           header.record_header_size == sizeof(vs_logger::record_header_t);
+}
+
+void Logger::openLogFile(const std::filesystem::path &path) {
+    auto segments = vs_logger::list_segments(path);
+    fileOpened = std::chrono::steady_clock::now();
+    fileTemplates.clear();
+    fileInterning = false;
+
+    if (config.file_storage == storage_t::MMAP) {
+        // Resume from the most recent segment, if any, unless it has already been archived.
+        uint64_t last = 0;
+        if (!segments.empty()) last = segments.back().first + (segments.back().second ? 1 : 0);
+        openSegment(last);
+        return;
+    }
+    // Rotation continues after the last rotated file.
+    segmentNumber = segments.empty() ? 0 : segments.back().first;
+
+    // Open the log file (located in tmpfs under /tmp). O_APPEND makes every write land at the end.
+    logFileFd = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (logFileFd < 0) {
+        std::cerr << "Failed to open log file: " << path << ": " << strerror(errno) << std::endl;
+        return;
+    }
+    fileOffset = lseek(logFileFd, 0, SEEK_END);
+
+    if (config.file_format != format_t::BINARY) return;
+
+    vs_logger::segment_header_t header{};
+    if (fileOffset == 0) {
+        fillSegmentHeader(header);
+        fileBuffer.append((const char*)&header, sizeof(header));
+        fileOffset = sizeof(header);
+    }
+    else if (pread(logFileFd, &header, sizeof(header), 0) != sizeof(header) || !checkSegmentHeader(header)) {
+        std::cerr << "Log file is not a compatible binary log: " << path << std::endl;
+        close(logFileFd);
+        logFileFd = -1;
+        return;
+    }
+    // Older files are appended to with text messages only.
+    fileInterning = header.version >= 2;
+
+    auto indexPath = path;
+    indexPath += ".idx";
+    openIndex(indexPath);
+}
+
+void Logger::openIndex(const std::filesystem::path &indexPath) {
+    indexFileFd = open(indexPath.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (indexFileFd < 0) {
+        std::cerr << "Failed to open log index: " << indexPath << ": " << strerror(errno) << std::endl;
+        return;
+    }
+
+    // Continue the sequence and the timestamps of an existing file, so both stay sorted along the index.
+    // A record torn by a crash is dropped, or every following one would be misaligned.
+    vs_logger::index_entry_t last;
+    off_t indexSize = lseek(indexFileFd, 0, SEEK_END);
+    if (indexSize % sizeof(last) != 0) {
+        indexSize -= indexSize % sizeof(last);
+        if (ftruncate(indexFileFd, indexSize) < 0)
+            std::cerr << "Failed to repair log index: " << indexPath << ": " << strerror(errno) << std::endl;
+    }
+    if (indexSize > 0 && pread(indexFileFd, &last, sizeof(last), indexSize - sizeof(last)) == sizeof(last)) {
+        seq_id = std::max(seq_id, last.seq_id);
+        clock.resume(last.timestamp);
+    }
 }
 
-static std::string escape_json(const std::string &s) {
-    std::string result;
-    for (auto c : s) {
-        switch(c) {
-            case '"': result += "\\\""; break;
-            case '\\': result += "\\\\"; break;
-            case '\b': result += "\\b";  break;
-            case '\f': result += "\\f";  break;
-            case '\n': result += "\\n";  break;
-            case '\r': result += "\\r";  break;
-            case '\t': result += "\\t";  break;
-            default:
-                result.push_back(c);
+void Logger::openSegment(uint64_t n) {
+    auto path = vs_logger::segment_path(*logFilePath, n);
+    segmentNumber = n;
+    activeSegment.store(n);
+    fileTemplates.clear();
+    fileInterning = false;
+
+    logFileFd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (logFileFd < 0) {
+        std::cerr << "Failed to open log segment: " << path << ": " << strerror(errno) << std::endl;
+        return;
+    }
+    off_t size = lseek(logFileFd, 0, SEEK_END);
+
+    // Reserve the whole segment up front, so writing into the mapping never hits ENOSPC as SIGBUS.
+    if (fallocate(logFileFd, 0, 0, config.segment_size) < 0 && ftruncate(logFileFd, config.segment_size) < 0) {
+        std::cerr << "Failed to preallocate log segment: " << path << ": " << strerror(errno) << std::endl;
+        close(logFileFd);
+        logFileFd = -1;
+        return;
+    }
+
+    void *map = mmap(nullptr, config.segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, logFileFd, 0);
+    if (map == MAP_FAILED) {
+        std::cerr << "Failed to map log segment: " << path << ": " << strerror(errno) << std::endl;
+        close(logFileFd);
+        logFileFd = -1;
+        return;
+    }
+    segmentMap = (char*)map;
+
+    if (config.file_format == format_t::BINARY) {
+        auto &header = *(vs_logger::segment_header_t*)segmentMap;
+        if (size == 0) {
+            fillSegmentHeader(header);
+            segmentUsed = sizeof(header);
+        }
+        else if (!checkSegmentHeader(header)) {
+            std::cerr << "Log segment is not a compatible binary log: " << path << std::endl;
+            closeSegment();
+            return;
+        }
+        else {
+            // Walk the records: the zeroed tail of the preallocation marks the end. Templates defined
+            // before are not looked for, new entries define them again.
+            segmentUsed = sizeof(header);
+            vs_logger::record_header_t record;
+            while (segmentUsed + sizeof(record) <= config.segment_size) {
+                memcpy(&record, segmentMap + segmentUsed, sizeof(record));
+                if (record.seq_id == 0 ||
+                    segmentUsed + sizeof(record) + record.length + record.fields_length > config.segment_size) break;
+                segmentUsed += sizeof(record) + record.length + record.fields_length;
+            }
+        }
+
+        fileInterning = header.version >= 2;
+
+        auto indexPath = path;
+        indexPath += ".idx";
+        openIndex(indexPath);
+    }
+    else {
+        segmentUsed = size;
+        if (size > 0) {
+            auto end = (const char*)memchr(segmentMap, '\0', std::min<size_t>(size, config.segment_size));
+            if (end) segmentUsed = end - segmentMap;
         }
     }
-    return result;
 }
 
-void Logger::writeToFS(const log_entry_t& entry, const std::string &message) {
-    if (!logFileStream.is_open()) {
+void Logger::closeSegment() {
+    flushFile();
+    munmap(segmentMap, config.segment_size);
+    segmentMap = nullptr;
+    // Give back the unused preallocation; readers never look past the last indexed record.
+    if (ftruncate(logFileFd, segmentUsed) < 0)
+        std::cerr << "Failed to trim log segment: " << strerror(errno) << std::endl;
+    close(logFileFd);
+    logFileFd = -1;
+    if (indexFileFd >= 0) {
+        close(indexFileFd);
+        indexFileFd = -1;
+    }
+}
+
+bool Logger::reserveSegment(size_t size) {
+    if (segmentUsed + size <= config.segment_size) return true;
+    size_t headerSize = config.file_format == format_t::BINARY ? sizeof(vs_logger::segment_header_t) : 0;
+    if (size + headerSize > config.segment_size) {
+        std::cerr << "Log entry larger than a segment, dropped" << std::endl;
+        return false;
+    }
+    closeSegment();
+    openSegment(segmentNumber + 1);
+    archiveSegment(segmentNumber - 1);
+    return segmentMap != nullptr;
+}
+
+bool Logger::rotationDue(std::chrono::steady_clock::time_point now) const {
+    size_t headerSize = config.file_format == format_t::BINARY ? sizeof(vs_logger::segment_header_t) : 0;
+    if (fileOffset <= headerSize) return false;
+    return (config.rotate_bytes > 0 && fileOffset >= config.rotate_bytes) ||
+           (config.rotate_interval.count() > 0 && now - fileOpened >= config.rotate_interval);
+}
+
+void Logger::rotateFile() {
+    flushFile();
+    close(logFileFd);
+    logFileFd = -1;
+    if (indexFileFd >= 0) {
+        close(indexFileFd);
+        indexFileFd = -1;
+    }
+
+    // Only this thread writes the file, so renaming it while it is closed is the whole switch:
+    // readers either see the old file under its new name or the new one.
+    auto &path = *logFilePath;
+    auto target = vs_logger::segment_path(path, segmentNumber + 1);
+    std::error_code ec;
+    std::filesystem::rename(path, target, ec);
+    if (!ec && config.file_format == format_t::BINARY) {
+        auto indexPath = path, targetIndex = target;
+        indexPath += ".idx";
+        targetIndex += ".idx";
+        std::filesystem::rename(indexPath, targetIndex, ec);
+    }
+    if (ec) std::cerr << "Failed to rotate log file: " << path << ": " << ec.message() << std::endl;
+
+    openLogFile(path);
+    if (!ec) archiveSegment(segmentNumber);
+}
+
+void Logger::archiveSegment(uint64_t n) {
+    if (!archiverThread.joinable()) return;
+    std::lock_guard<std::mutex> lock(archiveMutex);
+    archiveQueue.push_back(n);
+    archiveCv.notify_one();
+}
+
+void Logger::archiverLoop() {
+    // Compression only runs on otherwise idle CPU time.
+    sched_param param{};
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+
+    applyRetention();
+    std::unique_lock<std::mutex> lock(archiveMutex);
+    for (;;) {
+        archiveCv.wait(lock, [this]() { return archiveStopping || !archiveQueue.empty(); });
+        if (archiveStopping) return;
+        uint64_t n = archiveQueue.front();
+        archiveQueue.erase(archiveQueue.begin());
+        lock.unlock();
+
+        auto path = vs_logger::segment_path(*logFilePath, n);
+        if (config.compress_segments && std::filesystem::exists(path))
+            vs_logger::compress_segment(path);
+        applyRetention();
+
+        lock.lock();
+    }
+}
+
+void Logger::applyRetention() {
+    if (config.retain_segments == 0) return;
+    std::vector<uint64_t> finished;
+    for (auto [n, compressed] : vs_logger::list_segments(*logFilePath))
+        if (n < activeSegment.load() && (finished.empty() || finished.back() != n)) finished.push_back(n);
+
+    for (size_t i = 0; i + config.retain_segments < finished.size(); i++) {
+        auto path = vs_logger::segment_path(*logFilePath, finished[i]);
+        auto compressedPath = path, indexPath = path;
+        compressedPath += ".z";
+        indexPath += ".idx";
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+        std::filesystem::remove(compressedPath, ec);
+        std::filesystem::remove(indexPath, ec);
+    }
+}
+
+// Text metadata up to the message, at most textHeadBound bytes.
+static char *putTextHead(char *p, const Logger::log_entry_t &entry) {
+    p = putLiteral(p, textHeads[typeIndex(entry.type)][severityIndex(entry.sev)].view());
+    p = putInteger(p, entry.activity_uuid);
+    p = putLiteral(p, textSeq);
+    p = putInteger(p, entry.seq_id);
+    p = putLiteral(p, textParent);
+    p = putInteger(p, entry.parent_uuid);
+    return putLiteral(p, textMessage);
+}
+
+void Logger::formatText(std::string &out, const log_entry_t &entry, std::string_view message,
+                        std::string_view fields) {
+    size_t size = out.size();
+    bool hasFields = !fields.empty();
+    out.resize_and_overwrite(size + textHeadBound + message.size() + 1, [&](char *data, size_t) {
+        char *p = putLiteral(putTextHead(data + size, entry), message);
+        if (!hasFields) *p++ = '\n';
+        return p - data;
+    });
+    if (hasFields) {
+        vs_logger::fields_text(out, fields);
+        out += '\n';
+    }
+}
+
+void Logger::writeToFS(log_entry_t& entry, std::string_view message, std::string_view fields) {
+    if (logFileFd < 0) {
         std::cerr << "Log file not open!" << std::endl;
         return;
     }
 
-    // Format: timestamp [TYPE] {SEVERITY} Activity:<uuid> Seq:<seq> Parent:<parent> -- message
-    logFileStream.seekp(0, std::ios::end);
-    logFileStream << std::format("[{}], {{{}}}, Activity: {} Seq: {} Parent: {} -- {}\n",
-        to_string(entry.type),
-        to_string(entry.sev),
-        entry.activity_uuid,
-        entry.seq_id,
-        entry.parent_uuid,
-        message
-    );
-    logFileStream.flush();
-}
-
-void Logger::writeToWS(const log_entry_t &entry, const std::string &message) {
-    // Build JSON payload.
-    std::string payload = std::format(
-        "{{\"timestamp\":{},\"type\":\"{}\",\"severity\":\"{}\",\"activity_uuid\":\"{}\","
-        "\"seq_id\":{},\"parent_uuid\":\"{}\",\"message\":\"{}\"}}",
-        entry.timestamp,
-        to_string(entry.type),
-        to_string(entry.sev),
-        entry.activity_uuid,
-        entry.seq_id,
-        entry.parent_uuid,
-        escape_json(message)
-    );
-
-    ssize_t ret = sendto(udsSock, payload.c_str(), payload.size(), 0,
-                         (struct sockaddr*)&udsAddr, sizeof(udsAddr));
-    if (ret < 0) {
-        std::cerr << "notifySubscribers: Failed to send payload: " << strerror(errno) << std::endl;
-    }
-}
-
-void Logger::log(type_t type, severity_t sev, const std::string &message,
-                 uint64_t activity_uuid, uint64_t parent_uuid) {
-    std::lock_guard<std::mutex> lock(writeMutex);
+    auto now = std::chrono::steady_clock::now();
+    if (!segmentMap && rotationDue(now)) {
+        rotateFile();
+        if (logFileFd < 0) return;
+    }
+
+    // Templated entries keep the encoded arguments in BINARY files, referring to the format string
+    // written once per file. Make sure first that the entry, format included, fits in the segment: rolling
+    // over to the next one afterwards would leave the reference pointing into the previous one.
+    const vs_logger::format_template_t *format = nullptr;
+    if (entry.template_id && config.file_format == format_t::BINARY && fileInterning) {
+        format = templateOf(entry.template_id);
+        size_t worst = sizeof(vs_logger::record_header_t) + vs_logger::max_ref_bytes +
+                       (format ? format->format().size() : 0) + message.size() + fields.size();
+        if (format && segmentMap && !reserveSegment(worst)) return;
+    }
+
+    // MMAP storage encodes in a scratch buffer and copies the record straight into the mapping.
+    auto &out = segmentMap ? recordScratch : fileBuffer;
+    size_t before = out.size();
+    size_t length = message.size();
+    if (format) {
+        auto ref = fileTemplateRef(entry.template_id, segmentMap ? segmentUsed : fileOffset);
+        char encoded[vs_logger::max_ref_bytes];
+        size_t refLength = vs_logger::encode_ref(encoded, ref) - encoded;
+        length = refLength + ref.format_length + message.size();
+        auto header = makeRecord(entry, length, fields.size());
+        header.sev |= vs_logger::record_templated;
+        out.append((const char*)&header, sizeof(header));
+        out.append(encoded, refLength);
+        out.append(format->format().substr(0, ref.format_length));
+        out.append(message);
+        out.append(fields);
+    }
+    else if (config.file_format == format_t::BINARY) {
+        auto text = messageText(entry, message);
+        length = text.size();
+        auto header = makeRecord(entry, length, fields.size());
+        out.append((const char*)&header, sizeof(header));
+        out.append(text);
+        out.append(fields);
+    }
+    else formatText(out, entry, messageText(entry, message), fields);
+    counters->fileBytes.fetch_add(out.size() - before, std::memory_order_relaxed);
+
+    if (segmentMap) {
+        // Bump allocate in the mapping, no syscall involved.
+        bool reserved = reserveSegment(out.size());
+        if (reserved) {
+            entry.offset = segmentUsed;
+            memcpy(segmentMap + segmentUsed, out.data(), out.size());
+            segmentUsed += out.size();
+        }
+        out.clear();
+        if (!reserved) return;
+    }
+    else {
+        entry.offset = fileOffset;
+        fileOffset += out.size() - before;
+    }
+
+    if (config.file_format == format_t::BINARY) {
+        vs_logger::index_entry_t index{};
+        index.seq_id = entry.seq_id;
+        index.timestamp = entry.timestamp;
+        index.offset = entry.offset;
+        index.length = (uint32_t)length;
+        index.fields_length = (uint32_t)fields.size();
+        indexBuffer.append((const char*)&index, sizeof(index));
+    }
+
+    if (fileBuffer.size() + indexBuffer.size() >= config.flush_bytes ||
+        entry.type == type_t::ERROR || entry.type == type_t::PANIC ||
+        now - lastFlush >= config.flush_interval)
+        flushFile();
+}
+
+void Logger::flushFile() {
+    auto now = std::chrono::steady_clock::now();
+    lastFlush = now;
+    if (logFileFd < 0 || (fileBuffer.empty() && indexBuffer.empty())) return;
+
+    // Data goes first, so an index entry never points past the end of the log file.
+    if (!fileBuffer.empty() && !writeAll(logFileFd, fileBuffer.data(), fileBuffer.size()))
+        std::cerr << "Failed to write log file: " << strerror(errno) << std::endl;
+    fileBuffer.clear();
+
+    if (indexFileFd >= 0 && !indexBuffer.empty()) {
+        if (!writeAll(indexFileFd, indexBuffer.data(), indexBuffer.size()))
+            std::cerr << "Failed to write log index: " << strerror(errno) << std::endl;
+    }
+    indexBuffer.clear();
+
+    if (config.sync_interval.count() > 0 && now - lastSync >= config.sync_interval) {
+        if (segmentMap) msync(segmentMap, segmentUsed, MS_SYNC);
+        else fdatasync(logFileFd);
+        if (indexFileFd >= 0) fdatasync(indexFileFd);
+        lastSync = now;
+    }
+    counters->flushLatency.record(std::chrono::steady_clock::now() - now);
+}
+
+std::filesystem::path Logger::uds_shard_path(const std::filesystem::path &udsPath, unsigned n) {
+    if (n == 0) return udsPath;
+    auto path = udsPath;
+    path += "." + std::to_string(n);
+    return path;
+}
+
+// Everything up to the parent_uuid digits included, at most jsonHeadBound bytes.
+static char *putJsonHead(char *p, const Logger::log_entry_t &entry) {
+    p = putLiteral(p, jsonTimestamp);
+    p = putInteger(p, entry.timestamp);
+    p = putLiteral(p, jsonHeads[typeIndex(entry.type)][severityIndex(entry.sev)].view());
+    p = putInteger(p, entry.activity_uuid);
+    p = putLiteral(p, jsonSeq);
+    p = putInteger(p, entry.seq_id);
+    p = putLiteral(p, jsonParent);
+    return putInteger(p, entry.parent_uuid);
+}
+
+void Logger::formatJson(std::string &out, const log_entry_t &entry, std::string_view message,
+                        std::string_view fields) {
+    size_t size = out.size();
+    if (!fields.empty()) {
+        // Fields are rendered in between, so the entry is written in three steps.
+        out.resize_and_overwrite(size + jsonHeadBound + jsonFields.size(), [&](char *data, size_t) {
+            return putLiteral(putJsonHead(data + size, entry), jsonFields) - data;
+        });
+        vs_logger::fields_json(out, fields);
+        out += jsonFieldsMessage;
+        vs_logger::escape_json(out, message);
+        out += jsonEnd;
+        return;
+    }
+    size_t bound = jsonHeadBound + jsonMessage.size() + jsonEnd.size() + vs_logger::escaped_json_capacity(message.size());
+    out.resize_and_overwrite(size + bound, [&](char *data, size_t) {
+        char *p = putLiteral(putJsonHead(data + size, entry), jsonMessage);
+        p += vs_logger::escape_json(p, message);
+        p = putLiteral(p, jsonEnd);
+        return p - data;
+    });
+}
+
+void Logger::writeToWS(const log_entry_t &entry, std::string_view message, std::string_view fields) {
+    auto &shard = udsShards[entry.activity_uuid % udsShards.size()];
+
+    // The record is written in place in the ring, and published by flushWS(). An entry too large for one
+    // record goes in fragments, rather than as a datagram the server could read before the ring entries.
+    if (shard.ring) {
+        // Templated entries go as they are, the format string with the first one since the handshake.
+        std::string_view payload;
+        const vs_logger::format_template_t *format = entry.template_id ? templateOf(entry.template_id) : nullptr;
+        bool defines = false;
+        if (format) {
+            defines = entry.template_id >= shard.templates.size() || !shard.templates[entry.template_id];
+            vs_logger::template_ref_t ref{entry.template_id, defines ? format->format().size() : 0, 0};
+            char encoded[vs_logger::max_ref_bytes];
+            templateScratch.assign(encoded, vs_logger::encode_ref(encoded, ref));
+            if (defines) templateScratch += format->format();
+            templateScratch += message;
+            payload = templateScratch;
+        }
+        else payload = messageText(entry, message);
+
+        // Fragments hold the message bytes first, then the fields.
+        size_t limit = shard.ring->max_message();
+        for (;;) {
+            auto messagePart = payload.substr(0, limit);
+            auto fieldsPart = fields.substr(0, limit - messagePart.size());
+            payload.remove_prefix(messagePart.size());
+            fields.remove_prefix(fieldsPart.size());
+            bool last = payload.empty() && fields.empty();
+            auto header = makeRecord(entry, messagePart.size(), fieldsPart.size());
+            if (format) header.sev |= vs_logger::record_templated;
+            if (!last) header.sev |= vs_logger::record_continued;
+            if (!shard.ring->push(header, messagePart, fieldsPart)) {
+                counters->dropped.fetch_add(1, std::memory_order_relaxed);
+                announceRing(shard);
+                return;
+            }
+            counters->udsBytes.fetch_add(sizeof(header) + messagePart.size() + fieldsPart.size(), std::memory_order_relaxed);
+            if (last) break;
+        }
+        if (defines) {
+            if (shard.templates.size() <= entry.template_id) shard.templates.resize(entry.template_id + 1);
+            shard.templates[entry.template_id] = true;
+        }
+        return;
+    }
+
+    auto &wsBuffer = shard.buffer;
 
+    // Build JSON payload, newline-terminated so several of them can share a datagram.
+    size_t start = wsBuffer.size();
+    formatJson(wsBuffer, entry, messageText(entry, message), fields);
+
+    // Close the current datagram before this entry if the entry does not fit in it.
+    size_t limit = std::max<size_t>(config.uds_datagram_bytes, 1);
+    size_t datagramStart = shard.datagramEnds.empty() ? 0 : shard.datagramEnds.back();
+    if (start > datagramStart && wsBuffer.size() - datagramStart > limit) {
+        shard.datagramEnds.push_back(start);
+        datagramStart = start;
+    }
+    // A larger entry is cut in fragments that are just slices of the buffer. Only the last one ends
+    // with the newline, which tells the server to join them back.
+    while (wsBuffer.size() - datagramStart > limit) {
+        datagramStart += limit;
+        shard.datagramEnds.push_back(datagramStart);
+    }
+
+    // Bound the memory held by a long burst.
+    if (shard.datagramEnds.size() >= 64) flushWS(shard);
+}
+
+void Logger::flushWS() {
+    for (auto &shard : udsShards) flushWS(shard);
+}
+
+void Logger::flushWS(uds_shard_t &shard) {
+    if (shard.ring) {
+        shard.ring->publish();
+        // Nothing consumed since the last handshake: no server has the ring, yet or anymore.
+        if (!shard.ring->empty() && shard.ring->consumed() == shard.announcedTail) announceRing(shard);
+    }
+    auto &wsBuffer = shard.buffer;
+    auto &wsDatagramEnds = shard.datagramEnds;
+    if (wsBuffer.empty()) return;
+    if (wsDatagramEnds.empty() || wsDatagramEnds.back() != wsBuffer.size())
+        wsDatagramEnds.push_back(wsBuffer.size());
+
+    constexpr size_t MAX_BATCH = 64;
+    struct iovec iov[MAX_BATCH];
+    struct mmsghdr msgs[MAX_BATCH];
+
+    size_t sent = 0;
+    while (sent < wsDatagramEnds.size()) {
+        size_t count = std::min(MAX_BATCH, wsDatagramEnds.size() - sent);
+        for (size_t i = 0; i < count; i++) {
+            size_t begin = sent + i == 0 ? 0 : wsDatagramEnds[sent + i - 1];
+            iov[i].iov_base = wsBuffer.data() + begin;
+            iov[i].iov_len = wsDatagramEnds[sent + i] - begin;
+            memset(&msgs[i], 0, sizeof(msgs[i]));
+            msgs[i].msg_hdr.msg_name = &shard.addr;
+            msgs[i].msg_hdr.msg_namelen = sizeof(shard.addr);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int ret = sendmmsg(udsSock, msgs, count, 0);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            counters->udsFailures.fetch_add(1, std::memory_order_relaxed);
+            std::cerr << "notifySubscribers: Failed to send payload: " << strerror(errno) << std::endl;
+            break;
+        }
+        for (int i = 0; i < ret; i++) counters->udsBytes.fetch_add(msgs[i].msg_len, std::memory_order_relaxed);
+        sent += ret;
+    }
+
+    wsBuffer.clear();
+    wsDatagramEnds.clear();
+}
+
+void Logger::announceRing(uds_shard_t &shard) {
+    auto now = std::chrono::steady_clock::now();
+    if (shard.announced != std::chrono::steady_clock::time_point{} && now - shard.announced < std::chrono::seconds(1))
+        return;
+    shard.announced = now;
+    shard.announcedTail = shard.ring->consumed();
+    // A server attaching the ring again has none of the templates defined so far.
+    shard.templates.clear();
+
+    // One datagram starting with shm_handshake, carrying the memfd, the doorbell, and a pidfd of this
+    // process when the kernel has them so the server notices if we exit without closing the ring.
+    char marker = vs_logger::shm_handshake;
+    struct iovec iov = {&marker, sizeof(marker)};
+    int pidFd = -1;
+#ifdef SYS_pidfd_open
+    pidFd = (int)syscall(SYS_pidfd_open, getpid(), 0);
+#endif
+    int fds[3] = {shard.ring->memfd(), shard.ring->doorbell(), pidFd};
+    size_t fdsSize = (pidFd >= 0 ? 3 : 2) * sizeof(int);
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(fds))] = {};
+    struct msghdr msg = {};
+    msg.msg_name = &shard.addr;
+    msg.msg_namelen = sizeof(shard.addr);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(fdsSize);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(fdsSize);
+    memcpy(CMSG_DATA(cmsg), fds, fdsSize);
+    // Without a server yet the ring simply fills up, and is announced again then.
+    if (sendmsg(udsSock, &msg, MSG_DONTWAIT) < 0 && errno != ENOENT && errno != ECONNREFUSED) {
+        counters->udsFailures.fetch_add(1, std::memory_order_relaxed);
+        std::cerr << "notifySubscribers: Failed to announce shared memory ring: " << strerror(errno) << std::endl;
+    }
+    if (pidFd >= 0) close(pidFd);
+}
+
+Logger::metrics_t Logger::counters_t::snapshot() const {
+    metrics_t metrics;
+    metrics.entries = entries.load(std::memory_order_relaxed);
+    metrics.dropped = dropped.load(std::memory_order_relaxed);
+    metrics.suppressed = suppressed.load(std::memory_order_relaxed);
+    metrics.file_bytes = fileBytes.load(std::memory_order_relaxed);
+    metrics.uds_bytes = udsBytes.load(std::memory_order_relaxed);
+    metrics.uds_send_failures = udsFailures.load(std::memory_order_relaxed);
+    metrics.queue_depth = queueDepth.load(std::memory_order_relaxed);
+    metrics.queue_high_water = queueHighWater.load(std::memory_order_relaxed);
+    metrics.flush_latency = flushLatency.snapshot();
+    return metrics;
+}
+
+const vs_logger::format_template_t *Logger::templateOf(uint32_t id) {
+    if (id < templateCache.size() && templateCache[id]) return templateCache[id];
+    auto *format = vs_logger::interned_format(id);
+    if (templateCache.size() <= id) templateCache.resize(id + 1);
+    templateCache[id] = format;
+    return format;
+}
+
+std::string_view Logger::messageText(const log_entry_t &entry, std::string_view message) {
+    if (!entry.template_id) return message;
+    // Every output of the entry asks in turn, it is only rendered once.
+    if (expandedSeq != entry.seq_id) {
+        expandedText.clear();
+        if (auto *format = templateOf(entry.template_id)) format->expand(expandedText, message);
+        expandedSeq = entry.seq_id;
+    }
+    return expandedText;
+}
+
+vs_logger::template_ref_t Logger::fileTemplateRef(uint32_t id, uint64_t offset) {
+    if (fileTemplates.size() <= id) fileTemplates.resize(id + 1);
+    vs_logger::template_ref_t ref{id, 0, fileTemplates[id]};
+    if (ref.definition == 0) {
+        ref.format_length = templateOf(id)->format().size();
+        ref.definition = fileTemplates[id] = offset;
+    }
+    return ref;
+}
+
+void Logger::write(log_entry_t &entry, std::string_view message, std::string_view fields) {
+    counters->entries.fetch_add(1, std::memory_order_relaxed);
+    if(logFilePath.has_value())writeToFS(entry, message, fields);
+    if(udsPath.has_value())writeToWS(entry, message, fields);
+}
+
+Logger::staging_t &Logger::localStaging() {
+    struct cache_t {
+        uint64_t lastId = 0;
+        staging_t *last = nullptr;
+        std::vector<std::pair<uint64_t, std::shared_ptr<staging_t>>> buffers;
+
+        ~cache_t() {
+            for (auto &[id, buffer] : buffers)
+                buffer->orphaned.store(true, std::memory_order_release);
+        }
+    };
+    static thread_local cache_t cache;
+
+    if (cache.lastId == instanceId) return *cache.last;
+
+    for (auto &[id, buffer] : cache.buffers) {
+        if (id == instanceId) {
+            cache.lastId = id;
+            cache.last = buffer.get();
+            return *buffer;
+        }
+    }
+
+    // First entry from this thread: forget buffers of destroyed loggers and register a new one.
+    std::erase_if(cache.buffers, [](auto &item) { return item.second->detached.load(std::memory_order_acquire); });
+    auto buffer = std::make_shared<staging_t>(config.queue_capacity);
+    {
+        std::lock_guard<std::mutex> lock(stagingMutex);
+        stagingBuffers.push_back(buffer);
+        stagingGeneration.fetch_add(1);
+    }
+    cache.buffers.emplace_back(instanceId, buffer);
+    cache.lastId = instanceId;
+    cache.last = buffer.get();
+    return *buffer;
+}
+
+void Logger::notifyWriter() {
+    // Pairs with the fence in writerLoop(): either we see the writer idle, or it sees our entry.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (writerIdle.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wakeCv.notify_one();
+    }
+}
+
+void Logger::waitForWriter(staging_t &staging) {
+    // Either the writer sees this thread blocked and notifies, or the collection count read here is
+    // already the one after it freed cells.
+    blockedProducers.fetch_add(1);
+    uint64_t seen = collections.load();
+    if (staging.ring.size() >= staging.ring.capacity()) {
+        notifyWriter();
+        collections.wait(seen);
+    }
+    blockedProducers.fetch_sub(1);
+}
+
+size_t Logger::collect(std::vector<std::shared_ptr<staging_t>> &buffers) {
+    mergeWritten = 0;
+    mergeBatch.clear();
+    mergeArena.clear();
+    size_t depth = 0;
+    for (auto &buffer : buffers) depth += buffer->ring.size();
+    counters->queueDepth.store(depth, std::memory_order_relaxed);
+    if (depth > counters->queueHighWater.load(std::memory_order_relaxed))
+        counters->queueHighWater.store(depth, std::memory_order_relaxed);
+    for (auto &buffer : buffers) {
+        for (size_t i = 0; i < config.batch_size; i++) {
+            bool popped = buffer->ring.try_pop([this](record_t &record) {
+                size_t start = mergeArena.size();
+                if (record.render) {
+                    record.render(mergeArena, record.format, record.inline_message);
+                    record.render = nullptr;
+                    record.entry.length = mergeArena.size() - start;
+                }
+                else mergeArena.append(record.payload());
+                mergeBatch.push_back({record.entry, start});
+            });
+            if (!popped) {
+                buffer->owed = 0;
+                break;
+            }
+            if (buffer->owed > 0) buffer->owed--;
+        }
+    }
+    return mergeBatch.size();
+}
+
+void Logger::writerLoop() {
+    auto &buffers = writerBuffers;
+    uint64_t generation = 0;
+
+    auto refresh = [&]() {
+        uint64_t current = stagingGeneration.load();
+        if (current == generation) return;
+        std::lock_guard<std::mutex> lock(stagingMutex);
+        generation = stagingGeneration.load();
+        // A crash in the middle of the copy must not have crashFlush() walk a half-assigned vector.
+        refreshingBuffers.store(true, std::memory_order_relaxed);
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        buffers = stagingBuffers;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        refreshingBuffers.store(false, std::memory_order_relaxed);
+    };
+
+    auto allEmpty = [&]() {
+        for (auto &buffer : buffers)
+            if (!buffer->ring.empty()) return false;
+        return true;
+    };
+
+    // flush() request the owed counts of the buffers are for. Producers may keep the queues busy forever,
+    // so it is acknowledged once what was queued before it is written, not once they are empty.
+    uint64_t owedTarget = 0;
+    auto acknowledge = [&](uint64_t target) {
+        flushFile();
+        flushCompleted.store(target);
+        flushCompleted.notify_all();
+    };
+
+    for (;;) {
+        // Loaded before refresh(), so every buffer filled before the request is known.
+        uint64_t flushTarget = flushRequested.load();
+        refresh();
+        if (flushTarget != flushCompleted.load() && owedTarget <= flushCompleted.load()) {
+            owedTarget = flushTarget;
+            for (auto &buffer : buffers) buffer->owed = buffer->ring.size();
+        }
+        if (collect(buffers) > 0) {
+            collections.fetch_add(1);
+            if (blockedProducers.load() > 0) collections.notify_all();
+            // Each buffer is already in order, the merge only has to interleave them by time.
+            // Arena offsets grow in collection order, so ties keep the per-thread order without stable_sort's allocation.
+            std::sort(mergeBatch.begin(), mergeBatch.end(), [](const merged_t &a, const merged_t &b) {
+                return a.entry.timestamp != b.entry.timestamp ? a.entry.timestamp < b.entry.timestamp
+                                                              : a.arena_offset < b.arena_offset;
+            });
+            while (mergeWritten < mergeBatch.size()) {
+                auto &item = mergeBatch[mergeWritten++];
+                // Sequence numbers are assigned at merge time, so the outputs stay monotonic.
+                // The wall-clock conversion never goes back, even for an entry which missed its batch.
+                item.entry.seq_id = ++seq_id;
+                item.entry.timestamp = clock.to_wall(item.entry.timestamp);
+                std::string_view payload = std::string_view(mergeArena).substr(item.arena_offset);
+                write(item.entry, payload.substr(0, item.entry.length),
+                      payload.substr(item.entry.length, item.entry.fields_length));
+            }
+            reportSuppressed();
+            if (udsSock >= 0) flushWS();
+            if (owedTarget > flushCompleted.load() &&
+                std::all_of(buffers.begin(), buffers.end(), [](auto &buffer) { return buffer->owed == 0; }))
+                acknowledge(owedTarget);
+            continue;
+        }
+        if (reportSuppressed() && udsSock >= 0) flushWS();
+
+        // Drop buffers whose thread is gone and which have nothing left to drain.
+        bool pruned = false;
+        for (auto &buffer : buffers) {
+            if (buffer->orphaned.load(std::memory_order_acquire) && buffer->ring.empty()) {
+                std::lock_guard<std::mutex> lock(stagingMutex);
+                std::erase(stagingBuffers, buffer);
+                stagingGeneration.fetch_add(1);
+                pruned = true;
+            }
+        }
+        if (pruned) continue;
+
+        // Everything queued before the check has been written: honour pending flush() calls.
+        if (flushTarget != flushCompleted.load() || !fileBuffer.empty() || !indexBuffer.empty()) {
+            if (flushTarget != flushCompleted.load()) acknowledge(flushTarget);
+            else if (std::chrono::steady_clock::now() - lastFlush >= config.flush_interval) flushFile();
+        }
+
+        if (stopping.load()) {
+            refresh();
+            if (allEmpty()) break;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        writerIdle.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (stagingGeneration.load(std::memory_order_relaxed) == generation && allEmpty() && !stopping.load() &&
+            flushRequested.load() == flushCompleted.load()) {
+            // Wake up in time for the group commit if something is still buffered.
+            auto timeout = fileBuffer.empty() && indexBuffer.empty() ? std::chrono::microseconds(100000) : config.flush_interval;
+            wakeCv.wait_for(lock, timeout);
+        }
+        writerIdle.store(false, std::memory_order_relaxed);
+    }
+}
+
+std::string &Logger::formatBuffer() {
+    static thread_local std::string buffer;
+    return buffer;
+}
+
+std::string &Logger::fieldsBuffer() {
+    static thread_local std::string buffer;
+    return buffer;
+}
+
+Logger::log_entry_t Logger::makeEntry(type_t type, severity_t sev, uint64_t activity_uuid, uint64_t parent_uuid) {
     log_entry_t entry;
     entry.type = type;
     entry.sev = sev;
-    entry.timestamp = getTimestamp();
+    entry.timestamp = clock.now();
     entry.activity_uuid = activity_uuid;
-    entry.seq_id = ++seq_id;
+    entry.seq_id = 0;
     entry.parent_uuid = parent_uuid;
-    // In this example, we skip recording offset; OR set it to 0.
+    // The real offset is only known once the entry reaches the file.
     entry.offset = 0;
-    entry.length = message.size();
-
-    if(logFilePath.has_value())writeToFS(entry, message);
-    if(udsPath.has_value())writeToWS(entry, message);
+    entry.length = 0;
+    entry.fields_length = 0;
+    entry.template_id = 0;
+    return entry;
 }
 
-#ifndef LOG_HEADLESS
+void Logger::log(type_t type, severity_t sev, std::string_view message,
+                 uint64_t activity_uuid, uint64_t parent_uuid) {
+    if (!enabled(type, sev)) return;
+    submit(makeEntry(type, sev, activity_uuid, parent_uuid), message, {}, {});
+}
 
-void Logger::start_server(uint16_t port) {
-    if(udsPath.has_value()){
-        // Start the web server (which will act as the UDS listener as well).
-        webServerThread = std::thread([this, port]() {
-            // Start Crow application.
-            crow::SimpleApp app;
-
-            // Container to hold active WebSocket connections.
-            std::set<crow::websocket::connection*> wsConnections;
-            std::mutex wsMutex;
-
-            // Serve the webpage.
-            CROW_ROUTE(app, "/")
-            ([]() consteval -> const char* {
-                return R"raw(
-<!DOCTYPE html>
-<html>
-<head>
-  <meta charset="utf-8">
-  <title>Advanced Live Log Viewer</title>
-  <style>
-    html, body {
-      height: 100%;
-      margin: 0;
-    }
-    /* Base layout & colors */
-    body {
-      font-family: Arial, sans-serif;
-      background-color: var(--bg-color);
-      color: var(--text-color);
-      display: flex;
-      flex-direction: column;
-    }
-    header {
-      background-color: var(--header-bg);
-      border-bottom: 1px solid var(--border-color);
-      display: flex;
-      align-items: center;
-      padding: 5px 10px;
-    }
-    header .connStatus {
-      font-size: 1.5em;
-      margin-right: 10px;
-    }
-    header h1 {
-      flex: 1;
-      margin: 0;
-      font-size: 1.5em;
-    }
-    header button {
-      margin-left: 10px;
-    }
-    .controls {
-      background-color: var(--header-bg);
-      border-bottom: 1px solid var(--border-color);
-      padding: 10px;
-    }
-    .controls label {
-      margin-right: 5px;
-    }
-    .controls input,
-    .controls select {
-      margin-right: 15px;
-      vertical-align: middle;
-    }
-    .controls button, .controls label.auto-scroll {
-      margin-right: 15px;
-      vertical-align: middle;
-    }
-    /* Light/dark theme variables */
-    :root {
-      --bg-color: #ffffff;
-      --text-color: #000000;
-      --header-bg: #f0f0f0;
-      --border-color: #ccc;
-      --table-header-bg: #e9e9e9;
-      --table-row-bg: #f8f8f8;
-    }
-    [data-theme="dark"] {
-      --bg-color: #1e1e1e;
-      --text-color: #e0e0e0;
-      --header-bg: #333;
-      --border-color: #555;
-      --table-header-bg: #444;
-      --table-row-bg: #262626;
-    }
-    /* Log panel styling: fill remaining screen space */
-    #logPanel {
-      flex: 1;
-      overflow-y: auto;
-      border-top: 1px solid var(--border-color);
-    }
-    table {
-      border-collapse: collapse;
-      width: 100%;
-    }
-    thead {
-      background-color: var(--table-header-bg);
-      position: sticky;
-      top: 0;
-      z-index: 1;
-    }
-    th, td {
-      padding: 8px;
-      border: 1px solid var(--border-color);
-      text-align: left;
-      font-family: monospace;
-      white-space: nowrap;
-      overflow: hidden;
-      text-overflow: ellipsis;
-    }
-    /* Set fixed widths for all columns except message */
-    th.timestamp, td.timestamp { width: 110px; }
-    th.type, td.type { width: 60px; text-align: center; }
-    th.severity, td.severity { width: 80px; }
-    th.parent, td.parent { width: 200px; cursor: pointer; }
-    th.activity, td.activity { width: 200px; cursor: pointer; }
-    th.seq, td.seq { width: 60px; }
-    th.message, td.message { width: auto; }
-  </style>
-</head>
-<body data-theme="light">
-  <header>
-    <!-- Connection Status Icon: chain when connected, broken chain when disconnected -->
-    <div class="connStatus" id="connStatus" title="Connection Status">⛓️</div>
-    <h1>Advanced Live Log Viewer</h1>
-    <button id="toggleTheme">Toggle Dark/Light</button>
-    <button id="muteAudioBtn">Mute Panic Audio</button>
-  </header>
-  <div class="controls">
-    <!-- Filter & Export Controls -->
-    <label title="Type: OK = Successful, INFO = Information, WARNING = Warning, ERROR = Error, PANIC = Panic">Type</label>
-    <select id="filterType">
-      <option value="">(All)</option>
-      <option value="OK">✔️ OK – Successful</option>
-      <option value="INFO">ℹ️ INFO – Information</option>
-      <option value="WARNING">⚠️ WARNING – Warning</option>
-      <option value="ERROR">❌ ERROR – Error</option>
-      <option value="PANIC">⛔ PANIC – Panic</option>
-    </select>
-
-    <label title="Severity: NONE, LOW, MID, HIGH">Severity</label>
-    <select id="filterSeverity">
-      <option value="">(All)</option>
-      <option value="NONE">NONE</option>
-      <option value="LOW">LOW</option>
-      <option value="MID">MID</option>
-      <option value="HIGH">HIGH</option>
-    </select>
-
-    <label title="Activity UUID">Activity 🆔</label>
-    <input type="text" id="filterActivity" placeholder="Activity UUID">
-
-    <label title="Parent UUID">Parent 🔗</label>
-    <input type="text" id="filterParent" placeholder="Parent UUID">
-
-    <label title="Keyword Search">Search 🔍</label>
-    <input type="text" id="searchText" placeholder="Search text...">
-    
-    <button id="exportBtn">Export CSV</button>
-    <button id="clearLogsBtn">Clear Logs</button>
-    
-    <label class="auto-scroll" title="Toggle auto-scroll on/off">
-      <input type="checkbox" id="autoScroll" checked> Auto-scroll
-    </label>
-  </div>
-  <div id="logPanel">
-    <table id="logTable">
-      <thead>
-        <tr>
-          <th class="timestamp">Timestamp</th>
-          <th class="type">Type</th>
-          <th class="severity">Severity</th>
-          <th class="parent">Parent UUID</th>
-          <th class="activity">Activity UUID</th>
-          <th class="seq">Seq ID</th>
-          <th class="message">Message</th>
-        </tr>
-      </thead>
-      <tbody>
-      </tbody>
-    </table>
-  </div>
-
-  <!-- Audio element for PANIC logs -->
-  <audio id="panicSound" preload="auto">
-    <source src="data:audio/wav;base64,UklGRhwMAABXQVZFZm10IBAAAAABAAEAgD4AAIA+AAABAAgAZGF0Ya4LAACAgICAgICAgICAgICAgICAgICAgICAgICAf3hxeH+AfXZ1eHx6dnR5fYGFgoOKi42aloubq6GOjI2Op7ythXJ0eYF5aV1AOFFib32HmZSHhpCalIiYi4SRkZaLfnhxaWptb21qaWBea2BRYmZTVmFgWFNXVVVhaGdbYGhZbXh1gXZ1goeIlot1k6yxtKaOkaWhq7KonKCZoaCjoKWuqqmurK6ztrO7tbTAvru/vb68vbW6vLGqsLOfm5yal5KKhoyBeHt2dXBnbmljVlJWUEBBPDw9Mi4zKRwhIBYaGRQcHBURGB0XFxwhGxocJSstMjg6PTc6PUxVV1lWV2JqaXN0coCHhIyPjpOenqWppK6xu72yxMu9us7Pw83Wy9nY29ve6OPr6uvs6ezu6ejk6erm3uPj3dbT1sjBzdDFuMHAt7m1r7W6qaCupJOTkpWPgHqAd3JrbGlnY1peX1hTUk9PTFRKR0RFQkRBRUVEQkdBPjs9Pzo6NT04Njs+PTxAPzo/Ojk6PEA5PUJAQD04PkRCREZLUk1KT1BRUVdXU1VRV1tZV1xgXltcXF9hXl9eY2VmZmlna3J0b3F3eHyBfX+JgIWJiouTlZCTmpybnqSgnqyrqrO3srK2uL2/u7jAwMLFxsfEv8XLzcrIy83JzcrP0s3M0dTP0drY1dPR1dzc19za19XX2dnU1NjU0dXPzdHQy8rMysfGxMLBvLu3ta+sraeioJ2YlI+MioeFfX55cnJsaWVjXVlbVE5RTktHRUVAPDw3NC8uLyknKSIiJiUdHiEeGx4eHRwZHB8cHiAfHh8eHSEhISMoJyMnKisrLCszNy8yOTg9QEJFRUVITVFOTlJVWltaXmNfX2ZqZ21xb3R3eHqAhoeJkZKTlZmhpJ6kqKeur6yxtLW1trW4t6+us7axrbK2tLa6ury7u7u9u7vCwb+/vr7Ev7y9v8G8vby6vru4uLq+tri8ubi5t7W4uLW5uLKxs7G0tLGwt7Wvs7avr7O0tLW4trS4uLO1trW1trm1tLm0r7Kyr66wramsqaKlp52bmpeWl5KQkImEhIB8fXh3eHJrbW5mYGNcWFhUUE1LRENDQUI9ODcxLy8vMCsqLCgoKCgpKScoKCYoKygpKyssLi0sLi0uMDIwMTIuLzQ0Njg4Njc8ODlBQ0A/RUdGSU5RUVFUV1pdXWFjZGdpbG1vcXJ2eXh6fICAgIWIio2OkJGSlJWanJqbnZ2cn6Kkp6enq62srbCysrO1uLy4uL+/vL7CwMHAvb/Cvbq9vLm5uba2t7Sysq+urqyqqaalpqShoJ+enZuamZqXlZWTkpGSkpCNjpCMioqLioiHhoeGhYSGg4GDhoKDg4GBg4GBgoGBgoOChISChISChIWDg4WEgoSEgYODgYGCgYGAgICAgX99f398fX18e3p6e3t7enp7fHx4e3x6e3x7fHx9fX59fn1+fX19fH19fnx9fn19fX18fHx7fHx6fH18fXx8fHx7fH1+fXx+f319fn19fn1+gH9+f4B/fn+AgICAgH+AgICAgIGAgICAgH9+f4B+f35+fn58e3t8e3p5eXh4d3Z1dHRzcXBvb21sbmxqaWhlZmVjYmFfX2BfXV1cXFxaWVlaWVlYV1hYV1hYWVhZWFlaWllbXFpbXV5fX15fYWJhYmNiYWJhYWJjZGVmZ2hqbG1ub3Fxc3V3dnd6e3t8e3x+f3+AgICAgoGBgoKDhISFh4aHiYqKi4uMjYyOj4+QkZKUlZWXmJmbm52enqCioqSlpqeoqaqrrK2ur7CxsrGys7O0tbW2tba3t7i3uLe4t7a3t7i3tre2tba1tLSzsrKysbCvrq2sq6qop6alo6OioJ+dnJqZmJeWlJKSkI+OjoyLioiIh4WEg4GBgH9+fXt6eXh3d3V0c3JxcG9ubWxsamppaWhnZmVlZGRjYmNiYWBhYGBfYF9fXl5fXl1dXVxdXF1dXF1cXF1cXF1dXV5dXV5fXl9eX19gYGFgYWJhYmFiY2NiY2RjZGNkZWRlZGVmZmVmZmVmZ2dmZ2hnaGhnaGloZ2hpaWhpamlqaWpqa2pra2xtbGxtbm1ubm5vcG9wcXBxcnFycnN0c3N0dXV2d3d4eHh5ent6e3x9fn5/f4CAgIGCg4SEhYaGh4iIiYqLi4uMjY2Oj5CQkZGSk5OUlJWWlpeYl5iZmZqbm5ybnJ2cnZ6en56fn6ChoKChoqGio6KjpKOko6SjpKWkpaSkpKSlpKWkpaSlpKSlpKOkpKOko6KioaKhoaCfoJ+enp2dnJybmpmZmJeXlpWUk5STkZGQj4+OjYyLioqJh4eGhYSEgoKBgIB/fn59fHt7enl5eHd3dnZ1dHRzc3JycXBxcG9vbm5tbWxrbGxraWppaWhpaGdnZ2dmZ2ZlZmVmZWRlZGVkY2RjZGNkZGRkZGRkZGRkZGRjZGRkY2RjZGNkZWRlZGVmZWZmZ2ZnZ2doaWhpaWpra2xsbW5tbm9ub29wcXFycnNzdHV1dXZ2d3d4eXl6enp7fHx9fX5+f4CAgIGAgYGCgoOEhISFhoWGhoeIh4iJiImKiYqLiouLjI2MjI2OjY6Pj46PkI+QkZCRkJGQkZGSkZKRkpGSkZGRkZKRkpKRkpGSkZKRkpGSkZKRkpGSkZCRkZCRkI+Qj5CPkI+Pjo+OjY6Njo2MjYyLjIuMi4qLioqJiomJiImIh4iHh4aHhoaFhoWFhIWEg4SDg4KDgoKBgoGAgYCBgICAgICAf4CAf39+f35/fn1+fX59fHx9fH18e3x7fHt6e3p7ent6e3p5enl6enl6eXp5eXl4eXh5eHl4eXh5eHl4eXh5eHh3eHh4d3h4d3h3d3h4d3l4eHd4d3h3eHd4d3h3eHh4eXh5eHl4eHl4eXh5enl6eXp5enl6eXp5ent6ent6e3x7fHx9fH18fX19fn1+fX5/fn9+f4B/gH+Af4CAgICAgIGAgYCBgoGCgYKCgoKDgoOEg4OEg4SFhIWEhYSFhoWGhYaHhoeHhoeGh4iHiIiHiImIiImKiYqJiYqJiouKi4qLiouKi4qLiouKi4qLiouKi4qLi4qLiouKi4qLiomJiomIiYiJiImIh4iIh4iHhoeGhYWGhYaFhIWEg4OEg4KDgoOCgYKBgIGAgICAgH+Af39+f359fn18fX19fHx8e3t6e3p7enl6eXp5enl6enl5eXh5eHh5eHl4eXh5eHl4eHd5eHd3eHl4d3h3eHd4d3h3eHh4d3h4d3h3d3h5eHl4eXh5eHl5eXp5enl6eXp7ent6e3p7e3t7fHt8e3x8fHx9fH1+fX59fn9+f35/gH+AgICAgICAgYGAgYKBgoGCgoKDgoOEg4SEhIWFhIWFhoWGhYaGhoaHhoeGh4aHhoeIh4iHiIeHiIeIh4iHiIeIiIiHiIeIh4iHiIiHiIeIh4iHiIeIh4eIh4eIh4aHh4aHhoeGh4aHhoWGhYaFhoWFhIWEhYSFhIWEhISDhIOEg4OCg4OCg4KDgYKCgYKCgYCBgIGAgYCBgICAgICAgICAf4B/f4B/gH+Af35/fn9+f35/fn1+fn19fn1+fX59fn19fX19fH18fXx9fH18fXx9fH18fXx8fHt8e3x7fHt8e3x7fHt8e3x7fHt8e3x7fHt8e3x7fHt8e3x8e3x7fHt8e3x7fHx8fXx9fH18fX5+fX59fn9+f35+f35/gH+Af4B/gICAgICAgICAgICAgYCBgIGAgIGAgYGBgoGCgYKBgoGCgYKBgoGCgoKDgoOCg4KDgoOCg4KDgoOCg4KDgoOCg4KDgoOCg4KDgoOCg4KDgoOCg4KDgoOCg4KDgoOCg4KDgoOCg4KCgoGCgYKBgoGCgYKBgoGCgYKBgoGCgYKBgoGCgYKBgoGCgYKBgoGCgYKBgoGBgYCBgIGAgYCBgIGAgYCBgIGAgYCBgIGAgYCBgIGAgYCAgICBgIGAgYCBgIGAgYCBgIGAgYCBgExJU1RCAAAASU5GT0lDUkQMAAAAMjAwOC0wOS0yMQAASUVORwMAAAAgAAABSVNGVBYAAABTb255IFNvdW5kIEZvcmdlIDguMAAA" />
-    Your browser does not support the audio element.
-  </audio>
-
-  <script>
-    // Utility function to save settings to localStorage
-    function saveSettings() {
-      const settings = {
-        filterType: document.getElementById("filterType").value,
-        filterSeverity: document.getElementById("filterSeverity").value,
-        filterActivity: document.getElementById("filterActivity").value,
-        filterParent: document.getElementById("filterParent").value,
-        searchText: document.getElementById("searchText").value,
-        autoScroll: document.getElementById("autoScroll").checked,
-        theme: document.body.getAttribute("data-theme"),
-        panicAudioMuted: document.getElementById("panicSound").muted
-      };
-      localStorage.setItem("logViewerSettings", JSON.stringify(settings));
-    }
-
-    // Utility function to load settings from localStorage
-    function loadSettings() {
-      const settingsStr = localStorage.getItem("logViewerSettings");
-      if (settingsStr) {
-        const settings = JSON.parse(settingsStr);
-        document.getElementById("filterType").value = settings.filterType || "";
-        document.getElementById("filterSeverity").value = settings.filterSeverity || "";
-        document.getElementById("filterActivity").value = settings.filterActivity || "";
-        document.getElementById("filterParent").value = settings.filterParent || "";
-        document.getElementById("searchText").value = settings.searchText || "";
-        document.getElementById("autoScroll").checked = (settings.autoScroll === undefined) ? true : settings.autoScroll;
-        document.body.setAttribute("data-theme", settings.theme || "light");
-        document.getElementById("panicSound").muted = settings.panicAudioMuted || false;
-        updateMuteButton();
-      }
-    }
-
-    // Update mute button's label
-    function updateMuteButton() {
-      const muteBtn = document.getElementById("muteAudioBtn");
-      const panicAudioMuted = document.getElementById("panicSound").muted;
-      muteBtn.textContent = panicAudioMuted ? "Unmute Panic Audio" : "Mute Panic Audio";
-    }
-
-    // Data store for logs
-    let logStore = [];
-
-    // Colors for type icons only (the cell showing the unicode icon)
-    const typeColors = {
-      "OK": "#008000",       // green
-      "INFO": "#0000FF",     // blue
-      "WARNING": "#FFA500",  // orange
-      "ERROR": "#FF0000",    // red
-      "PANIC": "#800080"     // purple
-    };
+void Logger::log(type_t type, severity_t sev, std::string_view message, vs_logger::fields_t fields,
+                 uint64_t activity_uuid, uint64_t parent_uuid) {
+    if (!enabled(type, sev)) return;
+    submit(makeEntry(type, sev, activity_uuid, parent_uuid), message, {}, fields);
+}
 
-    // Unicode mapping for type filtering icons and tooltips.
-    const typeIcons = {
-      "OK": { icon: "✔️", title: "OK – Successful message" },
-      "INFO": { icon: "ℹ️", title: "INFO – Information message" },
-      "WARNING": { icon: "⚠️", title: "WARNING – Warning message" },
-      "ERROR": { icon: "❌", title: "ERROR – Error message" },
-      "PANIC": { icon: "⛔", title: "PANIC – Panic message" }
+void Logger::submit(log_entry_t entry, std::string_view message, vs_logger::fields_t args, vs_logger::fields_t fields) {
+    entry.length = message.size() + vs_logger::encoded_fields_size(args);
+    entry.fields_length = vs_logger::encoded_fields_size(fields);
+    auto encode = [&](char *payload) {
+        if (!message.empty()) memcpy(payload, message.data(), message.size());
+        return vs_logger::encode_fields(vs_logger::encode_fields(payload + message.size(), args), fields);
     };
 
-    // WebSocket setup & auto-reconnect
-    const wsUrl = "ws://" + location.host + "/ws";
-    let ws;
-    let reconnectInterval = 5000; // milliseconds
-
-    function setConnectionStatus(connected) {
-      const connStatusEl = document.getElementById("connStatus");
-      if (connected) {
-        connStatusEl.textContent = "⛓️"; // chain icon
-        connStatusEl.title = "Connected";
-      } else {
-        connStatusEl.textContent = "🔌"; // unplug icon
-        connStatusEl.title = "Disconnected";
-      }
-    }
-
-    function connectWebSocket() {
-      ws = new WebSocket(wsUrl);
-      ws.onopen = () => {
-        setConnectionStatus(true);
-      };
-      ws.onmessage = (event) => {
-        try {
-          const data = JSON.parse(event.data);
-          // Only add if seq_id not already present.
-          if (!logStore.some(log => log.seq_id === data.seq_id)) {
-            logStore.push(data);
-            // Sort logStore by seq_id.
-            logStore.sort((a, b) => a.seq_id - b.seq_id);
-            // Play sound for PANIC logs (if not muted).
-            if (data.type === "PANIC") {
-              const panicSound = document.getElementById("panicSound");
-              panicSound.play().catch(e => console.error(e));
+    if (async) {
+        // Arguments and fields are encoded straight into the queue slot, right after the message.
+        enqueue(entry.type, [&](record_t &record) {
+            record.entry = entry;
+            // The cell may have held a deferred entry, this one is text (and fields) already.
+            record.render = nullptr;
+            size_t size = entry.length + entry.fields_length;
+            char *payload = record.inline_message;
+            if (size <= record_t::inline_capacity) record.spill.clear();
+            else {
+                record.spill.resize(size);
+                payload = record.spill.data();
             }
-            renderLogs();
-          }
-        } catch (e) {
-          console.error("Error parsing message", e);
-        }
-      };
-      ws.onclose = () => {
-        setConnectionStatus(false);
-        setTimeout(connectWebSocket, reconnectInterval);
-      };
-      ws.onerror = (err) => {
-        console.error("WebSocket error", err);
-        ws.close();
-      };
-    }
-    connectWebSocket();
-
-    // Render table rows for logs
-    function renderLogs() {
-      const filterType = document.getElementById("filterType").value;
-      const filterSeverity = document.getElementById("filterSeverity").value;
-      const filterActivity = document.getElementById("filterActivity").value.trim().toLowerCase();
-      const filterParent = document.getElementById("filterParent").value.trim().toLowerCase();
-      const searchText = document.getElementById("searchText").value.toLowerCase();
-      const tbody = document.getElementById("logTable").querySelector("tbody");
-      tbody.innerHTML = "";
-      
-      // Filter logic: allow filtering by type, severity, activity_uuid, parent_uuid, and message content.
-      const filteredLogs = logStore.filter(log => {
-        const matchType = filterType ? log.type === filterType : true;
-        const matchSeverity = filterSeverity ? log.severity === filterSeverity : true;
-        const matchActivity = filterActivity ? (log.activity_uuid && log.activity_uuid.toLowerCase().includes(filterActivity)) : true;
-        const matchParent = filterParent ? (log.parent_uuid && log.parent_uuid.toLowerCase().includes(filterParent)) : true;
-        const matchText = searchText ? ((log.message && log.message.toLowerCase().includes(searchText)) ||
-                                        (log.activity_uuid && log.activity_uuid.toLowerCase().includes(searchText)) ||
-                                        (log.parent_uuid && log.parent_uuid.toLowerCase().includes(searchText))) : true;
-        return matchType && matchSeverity && matchActivity && matchParent && matchText;
-      });
-      
-      // Create a row for each filtered log.
-      for (const log of filteredLogs) {
-        const tr = document.createElement("tr");
-        
-        // Timestamp cell.
-        const tdTimestamp = document.createElement("td");
-        tdTimestamp.className = "timestamp";
-        tdTimestamp.textContent = log.timestamp;
-        tr.appendChild(tdTimestamp);
-
-        // Type cell with icon, color, and tooltip.
-        const tdType = document.createElement("td");
-        tdType.className = "type";
-        if (typeIcons[log.type]) {
-          tdType.textContent = typeIcons[log.type].icon;
-          tdType.title = typeIcons[log.type].title;
-          tdType.style.color = typeColors[log.type];
-        } else {
-          tdType.textContent = log.type;
-        }
-        tr.appendChild(tdType);
-        
-        // Severity cell.
-        const tdSeverity = document.createElement("td");
-        tdSeverity.className = "severity";
-        tdSeverity.textContent = log.severity;
-        tr.appendChild(tdSeverity);
-        
-        // Parent UUID cell (clickable)
-        const tdParent = document.createElement("td");
-        tdParent.className = "parent";
-        tdParent.textContent = log.parent_uuid;
-        tdParent.title = "Click to filter by Parent UUID";
-        tdParent.addEventListener("click", () => {
-          document.getElementById("filterParent").value = log.parent_uuid;
-          renderLogs();
-          saveSettings();
+            encode(payload);
         });
-        tr.appendChild(tdParent);
-        
-        // Activity UUID cell (clickable)
-        const tdActivity = document.createElement("td");
-        tdActivity.className = "activity";
-        tdActivity.textContent = log.activity_uuid;
-        tdActivity.title = "Click to filter by Activity UUID";
-        tdActivity.addEventListener("click", () => {
-          document.getElementById("filterActivity").value = log.activity_uuid;
-          renderLogs();
-          saveSettings();
+        return;
+    }
+
+    std::string_view payload = message;
+    if (payload.size() != entry.length + entry.fields_length) {
+        auto &buffer = fieldsBuffer();
+        buffer.resize_and_overwrite(entry.length + entry.fields_length, [&](char *data, size_t) {
+            return encode(data) - data;
         });
-        tr.appendChild(tdActivity);
-        
-        // Sequence ID cell.
-        const tdSeq = document.createElement("td");
-        tdSeq.className = "seq";
-        tdSeq.textContent = log.seq_id;
-        tr.appendChild(tdSeq);
-        
-        // Message cell.
-        const tdMessage = document.createElement("td");
-        tdMessage.className = "message";
-        tdMessage.textContent = log.message;
-        tr.appendChild(tdMessage);
-        
-        tbody.appendChild(tr);
-      }
-
-      // Auto-scroll if enabled.
-      if (document.getElementById("autoScroll").checked) {
-        const panel = document.getElementById("logPanel");
-        panel.scrollTop = panel.scrollHeight;
-      }
-    }
-
-    // Attach filtering events and save changes.
-    document.getElementById("filterType").addEventListener("change", () => { renderLogs(); saveSettings(); });
-    document.getElementById("filterSeverity").addEventListener("change", () => { renderLogs(); saveSettings(); });
-    document.getElementById("filterActivity").addEventListener("input", () => { renderLogs(); saveSettings(); });
-    document.getElementById("filterParent").addEventListener("input", () => { renderLogs(); saveSettings(); });
-    document.getElementById("searchText").addEventListener("input", () => { renderLogs(); saveSettings(); });
-    document.getElementById("autoScroll").addEventListener("change", saveSettings);
-
-    // CSV export functionality.
-    function escapeCSV(value) {
-      if (typeof value === 'string' && (value.includes(',') || value.includes('"') || value.includes('\n'))) {
-        return '"' + value.replace(/"/g, '""') + '"';
-      }
-      return value;
-    }
-    document.getElementById("exportBtn").addEventListener("click", () => {
-      const filterType = document.getElementById("filterType").value;
-      const filterSeverity = document.getElementById("filterSeverity").value;
-      const filterActivity = document.getElementById("filterActivity").value.trim().toLowerCase();
-      const filterParent = document.getElementById("filterParent").value.trim().toLowerCase();
-      const searchText = document.getElementById("searchText").value.toLowerCase();
-
-      const filteredLogs = logStore.filter(log => {
-        const matchType = filterType ? log.type === filterType : true;
-        const matchSeverity = filterSeverity ? log.severity === filterSeverity: true;
-        const matchActivity = filterActivity ? (log.activity_uuid && log.activity_uuid.toLowerCase().includes(filterActivity)) : true;
-        const matchParent = filterParent ? (log.parent_uuid && log.parent_uuid.toLowerCase().includes(filterParent)) : true;
-        const matchText = searchText ? ((log.message && log.message.toLowerCase().includes(searchText)) ||
-                                        (log.activity_uuid && log.activity_uuid.toLowerCase().includes(searchText)) ||
-                                        (log.parent_uuid && log.parent_uuid.toLowerCase().includes(searchText))) : true;
-        return matchType && matchSeverity && matchActivity && matchParent && matchText;
-      });
-      
-      let csvContent = "timestamp,type,severity,parent_uuid,activity_uuid,seq_id,message\n";
-      filteredLogs.forEach(log => {
-        csvContent += [
-          escapeCSV(log.timestamp),
-          escapeCSV(log.type),
-          escapeCSV(log.severity),
-          escapeCSV(log.parent_uuid),
-          escapeCSV(log.activity_uuid),
-          log.seq_id,
-          escapeCSV(log.message)
-        ].join(",") + "\n";
-      });
-      
-      const blob = new Blob([csvContent], { type: "text/csv;charset=utf-8;" });
-      const url = URL.createObjectURL(blob);
-      const a = document.createElement("a");
-      a.href = url;
-      a.download = "logs.csv";
-      document.body.appendChild(a);
-      a.click();
-      document.body.removeChild(a);
-    });
+        payload = buffer;
+    }
 
-    // Clear logs functionality.
-    document.getElementById("clearLogsBtn").addEventListener("click", () => {
-      logStore = [];
-      renderLogs();
-    });
+    // Taking the timestamp under the lock keeps it in the same order as seq_id.
+    std::lock_guard<std::mutex> lock(writeMutex);
+    writeOwner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+    entry.timestamp = clock.to_wall(clock.now());
+    entry.seq_id = ++seq_id;
+    write(entry, payload.substr(0, entry.length), payload.substr(entry.length));
+    reportSuppressed();
+    if (udsSock >= 0) flushWS();
+    writeOwner.store(std::thread::id(), std::memory_order_relaxed);
+}
 
-    // Toggle theme.
-    document.getElementById("toggleTheme").addEventListener("click", () => {
-      const bodyEl = document.body;
-      bodyEl.setAttribute("data-theme", bodyEl.getAttribute("data-theme") === "light" ? "dark" : "light");
-      saveSettings();
-    });
+bool Logger::admitSlow(vs_logger::log_site_t &site, type_t type, severity_t sev) {
+    if (sampleThreshold < UINT32_MAX && type <= config.sample_type && sev <= config.sample_severity) {
+        // xorshift64*, seeded once per thread from its stack address.
+        static thread_local uint64_t state = (uint64_t)(uintptr_t)&state * 0x9e3779b97f4a7c15u | 1;
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        if ((uint32_t)((state * 0x2545f4914f6cdd1du) >> 32) >= sampleThreshold) {
+            suppress(site, type, sev);
+            return false;
+        }
+    }
+    if (siteInterval == 0) return true;
 
-    // Mute/unmute panic audio.
-    document.getElementById("muteAudioBtn").addEventListener("click", () => {
-      const panicAudio = document.getElementById("panicSound");
-      panicAudio.muted = !panicAudio.muted;
-      updateMuteButton();
-      saveSettings();
-    });
+    uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    uint64_t next = site.next.load(std::memory_order_relaxed);
+    for (;;) {
+        uint64_t start = std::max(next, now);
+        if (start - now > siteTolerance) {
+            suppress(site, type, sev);
+            return false;
+        }
+        if (site.next.compare_exchange_weak(next, start + siteInterval, std::memory_order_relaxed)) return true;
+    }
+}
 
-    // Load settings on page load.
-    loadSettings();
-    renderLogs();
-  </script>
-</body>
-</html>
-)raw";
-            });
+void Logger::suppress(vs_logger::log_site_t &site, type_t type, severity_t sev) {
+    counters->suppressed.fetch_add(1, std::memory_order_relaxed);
+    site.suppressed.fetch_add(1, std::memory_order_relaxed);
+    if (site.owner.load(std::memory_order_acquire)) return;
 
-        // WebSocket endpoint.
-        CROW_WEBSOCKET_ROUTE(app, "/ws")
-        .onopen([&wsConnections, &wsMutex](crow::websocket::connection& conn) {
-            std::lock_guard<std::mutex> lock(wsMutex);
-            wsConnections.insert(&conn);
-            std::cout << "WebSocket connection opened" << std::endl;
-        })
-        .onclose([&wsConnections, &wsMutex](crow::websocket::connection& conn, const std::string& reason, uint16_t) {
-            std::lock_guard<std::mutex> lock(wsMutex);
-            wsConnections.erase(&conn);
-            std::cout << "WebSocket connection closed: " << reason << std::endl;
-        })
-        .onmessage([](crow::websocket::connection& /*conn*/, const std::string& /*data*/, bool /*is_binary*/) {
-            // Ignore client messages.
-        });
+    // First entry left out by this site: it reports to this Logger from now on.
+    const void *expected = nullptr;
+    site.level.store((uint16_t)((int)type << 8 | (int)sev), std::memory_order_relaxed);
+    if (!site.owner.compare_exchange_strong(expected, this, std::memory_order_acq_rel)) return;
+    std::lock_guard<std::mutex> lock(sitesMutex);
+    suppressingSites.push_back(&site);
+    hasSuppressingSites.store(true, std::memory_order_release);
+}
 
-        // Single UDS listener that uses the same udsPath_.
-        // This listener reads UDP datagrams and broadcasts them to all WebSocket clients.
-        std::thread udsBridgeThread([this, &wsConnections, &wsMutex]() {
-            int sockfd = socket(AF_UNIX, SOCK_DGRAM, 0);
-            if (sockfd < 0) {
-                std::cerr << "UDS Bridge: Failed to create socket: " << strerror(errno) << std::endl;
-                return;
-            }
-            // Remove any previous socket file and bind.
-            unlink(udsPath->c_str());
-            struct sockaddr_un addr;
-            memset(&addr, 0, sizeof(addr));
-            addr.sun_family = AF_UNIX;
-            strncpy(addr.sun_path, udsPath->c_str(), sizeof(addr.sun_path) - 1);
+bool Logger::reportSuppressed(bool force) {
+    if (!hasSuppressingSites.load(std::memory_order_acquire)) return false;
+    auto now = std::chrono::steady_clock::now();
+    if (!force && now < nextSuppressionReport) return false;
+    nextSuppressionReport = now + config.suppression_interval;
 
-            if (bind(sockfd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
-                std::cerr << "UDS Bridge: Failed to bind: " << strerror(errno) << std::endl;
-                close(sockfd);
-                return;
-            }
+    std::lock_guard<std::mutex> lock(sitesMutex);
+    std::string message;
+    bool reported = false;
+    for (auto *site : suppressingSites) {
+        uint64_t count = site->suppressed.exchange(0, std::memory_order_relaxed);
+        if (count == 0) continue;
+        uint16_t level = site->level.load(std::memory_order_relaxed);
+        message.clear();
+        std::format_to(std::back_inserter(message), "{} similar messages suppressed at {}:{}", count, site->file, site->line);
+        log_entry_t entry = makeEntry((type_t)(level >> 8), (severity_t)(level & 0xff), 0, 0);
+        entry.timestamp = clock.to_wall(clock.now());
+        entry.length = message.size();
+        entry.seq_id = ++seq_id;
+        write(entry, message);
+        reported = true;
+    }
+    return reported;
+}
 
-            constexpr size_t BUFFER_SIZE = 1024;
-            char buffer[BUFFER_SIZE];
-            while (true) {
-                ssize_t n = recv(sockfd, buffer, BUFFER_SIZE - 1, 0);
-                if (n > 0) {
-                    buffer[n] = '\0';
-                    // Print received message for debugging.
-                    std::cout << "UDS Bridge received: " << buffer << std::endl;
-                    // Broadcast the JSON message to all connected WebSocket clients.
-                    std::lock_guard<std::mutex> lock(wsMutex);
-                    for (auto* conn : wsConnections) {
-                        try {
-                            conn->send_text(std::string(buffer));
-                        } catch (const std::exception& ex) {
-                            std::cerr << "Failed to send via websocket: " << ex.what() << std::endl;
-                        }
-                    }
-                }
-                else {
-                    // Sleep briefly to avoid busy looping.
-                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                }
-            }
-            close(sockfd);
-        });
-        udsBridgeThread.detach();
+void Logger::flush() {
+    if (async) {
+        uint64_t target = flushRequested.fetch_add(1) + 1;
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            wakeCv.notify_one();
+        }
+        for (uint64_t done = flushCompleted.load(); done < target; done = flushCompleted.load())
+            flushCompleted.wait(done);
+        return;
+    }
 
-        app.port(port)./*multithreaded().*/run();
-    });
+    std::lock_guard<std::mutex> lock(writeMutex);
+    flushFile();
+}
 
-    // Detach the web server thread so it runs in the background.
-    webServerThread.detach();
+void Logger::awaitWriter() {
+    if (stopping.load() || std::this_thread::get_id() == writerThread.get_id()) return;
+    uint64_t target = flushRequested.fetch_add(1) + 1;
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wakeCv.notify_one();
+    }
+    waitFlushed(target, std::chrono::steady_clock::now() + config.crash_flush_timeout);
 }
-#endif
 
+bool Logger::waitFlushed(uint64_t target, std::chrono::steady_clock::time_point deadline) const {
+    while (flushCompleted.load() < target) {
+        if (std::chrono::steady_clock::now() >= deadline) return false;
+        struct timespec delay{0, 100000};
+        nanosleep(&delay, nullptr);
+    }
+    return true;
+}
+
+void Logger::crashSignal(int sig) {
+    // The first fatal signal saves the logs, one raised meanwhile by another thread waits for it to finish.
+    static std::atomic<bool> crashing{false};
+    if (crashing.exchange(true)) {
+        for (;;) pause();
+    }
+    int savedErrno = errno;
+    for (auto &slot : crashLoggers) {
+        if (Logger *logger = slot.load()) logger->crashFlush();
+    }
+    errno = savedErrno;
+
+    // Hand the signal over to the previous handler, delivered once this one returns.
+    for (size_t i = 0; i < std::size(crashSignals); i++) {
+        if (crashSignals[i] == sig) sigaction(sig, &previousActions[i], nullptr);
+    }
+    raise(sig);
+}
+
+void Logger::crashFlush() {
+    auto deadline = std::chrono::steady_clock::now() + config.crash_flush_timeout;
+
+    // Only the thread owning the outputs writes: a writer which is not the one crashing writes out the queues
+    // the usual way, formatting included. If it does not make it in time, it still owns them and nothing is
+    // written here.
+    bool locked = false;
+    if (async) {
+        if (std::this_thread::get_id() != writerThread.get_id()) {
+            if (!stopping.load()) waitFlushed(flushRequested.fetch_add(1) + 1, deadline);
+            return;
+        }
+    }
+    else if (writeOwner.load(std::memory_order_relaxed) != std::this_thread::get_id()) {
+        // Wait for another thread writing an entry to be done with it.
+        while (!(locked = writeMutex.try_lock())) {
+            if (std::chrono::steady_clock::now() >= deadline) return;
+            struct timespec delay{0, 100000};
+            nanosleep(&delay, nullptr);
+        }
+    }
+    if (logFileFd < 0) {
+        if (locked) writeMutex.unlock();
+        return;
+    }
+
+    // The group commit buffers hold the oldest entries, then come those the writer took from the queues,
+    // then those still queued.
+    if (!fileBuffer.empty() && writeAll(logFileFd, fileBuffer.data(), fileBuffer.size())) fileBuffer.clear();
+    if (indexFileFd >= 0 && !indexBuffer.empty() && writeAll(indexFileFd, indexBuffer.data(), indexBuffer.size()))
+        indexBuffer.clear();
+    if (async) {
+        while (mergeWritten < mergeBatch.size()) {
+            auto &item = mergeBatch[mergeWritten++];
+            std::string_view payload = std::string_view(mergeArena).substr(item.arena_offset);
+            crashWrite(item.entry, payload.substr(0, item.entry.length),
+                       payload.substr(item.entry.length, item.entry.fields_length));
+        }
+        // The writer's own snapshot: stagingBuffers may be reallocated by a producer registering right now.
+        // Queues registered since the last refresh are not written out, nor any while it is being refreshed.
+        if (!refreshingBuffers.load(std::memory_order_relaxed)) for (auto &buffer : writerBuffers) {
+            while (buffer->ring.try_pop([this](record_t &record) {
+                if (record.render) {
+                    record.render = nullptr;
+                    crashWrite(record.entry, record.format, {});
+                    return;
+                }
+                std::string_view payload = record.payload();
+                crashWrite(record.entry, payload.substr(0, record.entry.length), payload.substr(record.entry.length));
+            })) {}
+        }
+    }
+    if (locked) writeMutex.unlock();
+}
+
+void Logger::crashWrite(log_entry_t entry, std::string_view message, std::string_view fields) {
+    entry.seq_id = ++seq_id;
+    entry.timestamp = clock.wall_of(entry.timestamp);
+    bool binary = config.file_format == format_t::BINARY;
+
+    // Arguments cannot be rendered here: a templated entry stays one where the file defines its template
+    // already, otherwise it goes with its format string if the writer looked it up before.
+    char ref[vs_logger::max_ref_bytes];
+    size_t refLength = 0;
+    if (uint32_t id = entry.template_id) {
+        if (binary && fileInterning && id < fileTemplates.size() && fileTemplates[id]) {
+            refLength = vs_logger::encode_ref(ref, {id, 0, fileTemplates[id]}) - ref;
+        }
+        else {
+            auto *format = id < templateCache.size() ? templateCache[id] : nullptr;
+            message = format ? format->format() : std::string_view("<format not available>");
+        }
+    }
+
+    // Text lines go without their fields, rendering them allocates.
+    char head[std::max(textHeadBound, sizeof(vs_logger::record_header_t))];
+    size_t headLength;
+    if (binary) {
+        auto header = makeRecord(entry, refLength + message.size(), fields.size());
+        if (refLength) header.sev |= vs_logger::record_templated;
+        memcpy(head, &header, sizeof(header));
+        headLength = sizeof(header);
+    }
+    else {
+        headLength = putTextHead(head, entry) - head;
+        fields = {};
+    }
+    std::string_view parts[] = {{head, headLength}, {ref, refLength}, message, fields, binary ? "" : "\n"};
+
+    size_t total = 0;
+    for (auto part : parts) total += part.size();
+    if (segmentMap) {
+        // No rolling over to a new segment here, what does not fit is lost.
+        if (segmentUsed + total > config.segment_size) return;
+        entry.offset = segmentUsed;
+        for (auto part : parts) {
+            memcpy(segmentMap + segmentUsed, part.data(), part.size());
+            segmentUsed += part.size();
+        }
+    }
+    else {
+        entry.offset = fileOffset;
+        for (auto part : parts) {
+            if (!writeAll(logFileFd, part.data(), part.size())) return;
+        }
+        fileOffset += total;
+    }
+
+    if (binary && indexFileFd >= 0) {
+        vs_logger::index_entry_t index{};
+        index.seq_id = entry.seq_id;
+        index.timestamp = entry.timestamp;
+        index.offset = entry.offset;
+        index.length = (uint32_t)(refLength + message.size());
+        index.fields_length = (uint32_t)fields.size();
+        writeAll(indexFileFd, (const char*)&index, sizeof(index));
+    }
 }
@@ -0,0 +1,50 @@
+#include <format>
+#include <iterator>
+
+#include "vs-logger/metrics.hpp"
+
+void vs_logger::prometheus_header(std::string &out, std::string_view name, std::string_view type, std::string_view help) {
+    std::format_to(std::back_inserter(out), "# HELP {} {}\n# TYPE {} {}\n", name, help, name, type);
+}
+
+void vs_logger::prometheus_sample(std::string &out, std::string_view name, std::string_view labels, uint64_t value) {
+    if (labels.empty()) std::format_to(std::back_inserter(out), "{} {}\n", name, value);
+    else std::format_to(std::back_inserter(out), "{}{{{}}} {}\n", name, labels, value);
+}
+
+void vs_logger::prometheus_metric(std::string &out, std::string_view name, std::string_view type, std::string_view help,
+                                  uint64_t value) {
+    prometheus_header(out, name, type, help);
+    prometheus_sample(out, name, {}, value);
+}
+
+void vs_logger::prometheus_histogram(std::string &out, std::string_view name, std::string_view help,
+                                     const histogram_t::snapshot_t &histogram) {
+    prometheus_header(out, name, "histogram", help);
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i + 1 < histogram_t::bucket_count; i++) {
+        cumulative += histogram.counts[i];
+        std::format_to(std::back_inserter(out), "{}_bucket{{le=\"{}\"}} {}\n", name,
+                       (double)histogram_t::bucket_bound_us(i) * 1e-6, cumulative);
+    }
+    std::format_to(std::back_inserter(out), "{}_bucket{{le=\"+Inf\"}} {}\n", name, histogram.count);
+    std::format_to(std::back_inserter(out), "{}_sum {}\n{}_count {}\n", name, (double)histogram.sum_ns * 1e-9,
+                   name, histogram.count);
+}
+
+void vs_logger::write_prometheus(std::string &out, const logger_metrics_t &metrics) {
+    prometheus_metric(out, "vs_logger_entries_total", "counter", "Entries written to the outputs.", metrics.entries);
+    prometheus_metric(out, "vs_logger_dropped_entries_total", "counter",
+                      "Entries lost to the overflow policy or to a full shared memory ring.", metrics.dropped);
+    prometheus_metric(out, "vs_logger_suppressed_entries_total", "counter",
+                      "Entries left out by the rate limit or the sampling of call sites.", metrics.suppressed);
+    prometheus_metric(out, "vs_logger_file_bytes_total", "counter", "Bytes of entries written to the log file.",
+                      metrics.file_bytes);
+    prometheus_metric(out, "vs_logger_uds_bytes_total", "counter", "Bytes sent to the server over UDS.", metrics.uds_bytes);
+    prometheus_metric(out, "vs_logger_uds_send_failures_total", "counter", "Failed UDS sends.", metrics.uds_send_failures);
+    prometheus_metric(out, "vs_logger_queue_depth", "gauge", "Entries waiting for the writer thread.", metrics.queue_depth);
+    prometheus_metric(out, "vs_logger_queue_high_water", "gauge", "Most entries ever waiting for the writer thread.",
+                      metrics.queue_high_water);
+    prometheus_histogram(out, "vs_logger_flush_duration_seconds", "Time taken to write the buffered log file contents.",
+                         metrics.flush_latency);
+}
@@ -0,0 +1,301 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <utility>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "vs-logger/reader.hpp"
+
+static void decode(const vs_logger::record_header_t &header, uint64_t offset, Logger::log_entry_t &entry) {
+    entry.type = (Logger::type_t)header.type;
+    entry.sev = (Logger::severity_t)(header.sev & ~vs_logger::record_templated);
+    entry.timestamp = header.timestamp;
+    entry.activity_uuid = header.activity_uuid;
+    entry.seq_id = header.seq_id;
+    entry.parent_uuid = header.parent_uuid;
+    entry.offset = offset;
+    entry.length = header.length;
+    entry.fields_length = header.fields_length;
+    entry.template_id = 0;
+}
+
+LogReader::LogReader(const std::filesystem::path &logFilePath) {
+    auto indexPath = logFilePath;
+    if (indexPath.extension() == ".z") indexPath.replace_extension();
+
+    logFd = open(logFilePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (logFd < 0 && errno == ENOENT && logFilePath.extension() != ".z") {
+        // Rotated segments may have been compressed in the meantime.
+        auto compressedPath = logFilePath;
+        compressedPath += ".z";
+        logFd = open(compressedPath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (logFd >= 0) compressed = std::make_unique<vs_logger::compressed_segment>(dup(logFd));
+    }
+    else if (logFd >= 0 && logFilePath.extension() == ".z")
+        compressed = std::make_unique<vs_logger::compressed_segment>(dup(logFd));
+    if (logFd < 0 || (compressed && !compressed->is_open())) {
+        std::cerr << "Failed to open log file: " << logFilePath << ": " << strerror(errno) << std::endl;
+        if (logFd >= 0) close(logFd);
+        logFd = -1;
+        return;
+    }
+
+    vs_logger::segment_header_t header{};
+    if (!readRaw(0, &header, sizeof(header)) ||
+        memcmp(header.magic, vs_logger::segment_magic, sizeof(header.magic)) != 0 ||
+        header.version < 1 || header.version > vs_logger::segment_version ||
+        header.record_header_size != sizeof(vs_logger::record_header_t)) {
+        std::cerr << "Not a compatible binary log: " << logFilePath << std::endl;
+        close(logFd);
+        logFd = -1;
+        return;
+    }
+
+    indexPath += ".idx";
+    indexFd = open(indexPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (indexFd < 0) {
+        std::cerr << "Failed to open log index: " << indexPath << ": " << strerror(errno) << std::endl;
+    }
+}
+
+LogReader::~LogReader() {
+    for (auto &[map, size] : maps)
+        munmap((void*)map, size);
+    if (logFd >= 0) close(logFd);
+    if (indexFd >= 0) close(indexFd);
+}
+
+bool LogReader::readRaw(uint64_t offset, void *dst, size_t size) const {
+    if (compressed) return compressed->read(offset, dst, size);
+    return pread(logFd, dst, size, offset) == (ssize_t)size;
+}
+
+bool LogReader::fits(const vs_logger::record_header_t &header, uint64_t offset) const {
+    uint64_t end = offset + sizeof(header) + header.length + header.fields_length;
+    if (end <= knownSize) return true;
+    // The file only grows, so its size is only looked up again for records past the last one seen.
+    if (compressed) knownSize = compressed->size();
+    else {
+        struct stat st;
+        if (fstat(logFd, &st) < 0) return false;
+        knownSize = st.st_size;
+    }
+    return end <= knownSize;
+}
+
+bool LogReader::is_open() const {
+    return logFd >= 0 && indexFd >= 0;
+}
+
+bool LogReader::same_file(const std::filesystem::path &path) const {
+    struct stat opened, named;
+    return logFd >= 0 && fstat(logFd, &opened) == 0 && stat(path.c_str(), &named) == 0 &&
+           opened.st_dev == named.st_dev && opened.st_ino == named.st_ino;
+}
+
+size_t LogReader::size() const {
+    struct stat st;
+    if (indexFd < 0 || fstat(indexFd, &st) < 0) return 0;
+    // A partially written record at the end is not counted.
+    return st.st_size / sizeof(vs_logger::index_entry_t);
+}
+
+bool LogReader::index_at(size_t pos, vs_logger::index_entry_t &out) const {
+    off_t offset = pos * sizeof(vs_logger::index_entry_t);
+    return pread(indexFd, &out, sizeof(out), offset) == sizeof(out);
+}
+
+std::optional<size_t> LogReader::find_seq(uint64_t seq_id) const {
+    size_t pos = lower_bound_seq(seq_id);
+    vs_logger::index_entry_t item;
+    if (pos < size() && index_at(pos, item) && item.seq_id == seq_id) return pos;
+    return std::nullopt;
+}
+
+size_t LogReader::lower_bound_seq(uint64_t seq_id) const {
+    // Sequence numbers are strictly increasing along the index.
+    size_t lo = 0, hi = size();
+    vs_logger::index_entry_t item;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (!index_at(mid, item)) return mid;
+        if (item.seq_id < seq_id) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+size_t LogReader::lower_bound(uint64_t timestamp) const {
+    // The Logger keeps timestamps non-decreasing along the file.
+    size_t lo = 0, hi = size();
+    vs_logger::index_entry_t item;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (!index_at(mid, item)) return mid;
+        if (item.timestamp < timestamp) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+bool LogReader::read_at(uint64_t offset, Logger::log_entry_t &entry, std::string &message) const {
+    vs_logger::record_header_t header;
+    if (!readRaw(offset, &header, sizeof(header)) || !fits(header, offset)) return false;
+
+    decode(header, offset, entry);
+
+    message.resize(header.length);
+    if (!readRaw(offset + sizeof(header), message.data(), header.length)) return false;
+    if (header.sev & vs_logger::record_templated) {
+        if (!expandTemplate(message, expanded)) return false;
+        message.swap(expanded);
+    }
+    return true;
+}
+
+bool LogReader::read_at(uint64_t offset, Logger::log_entry_t &entry, std::string &message, std::string &fields) const {
+    vs_logger::record_header_t header;
+    if (!readRaw(offset, &header, sizeof(header)) || !fits(header, offset)) return false;
+
+    decode(header, offset, entry);
+
+    // Both come with one read, the fields are then moved out of the message buffer.
+    message.resize(header.length + header.fields_length);
+    if (!readRaw(offset + sizeof(header), message.data(), message.size())) return false;
+    fields.assign(message, header.length);
+    message.resize(header.length);
+    if (header.sev & vs_logger::record_templated) {
+        if (!expandTemplate(message, expanded)) return false;
+        message.swap(expanded);
+    }
+    return true;
+}
+
+bool LogReader::expandTemplate(std::string_view raw, std::string &out) const {
+    vs_logger::template_ref_t ref;
+    if (!vs_logger::decode_ref(raw, ref) || raw.size() < ref.format_length) return false;
+
+    auto it = templates.find(ref.definition);
+    if (it == templates.end()) {
+        // Read the format string from the record defining the template, unless it is this one.
+        std::string format(raw.substr(0, ref.format_length));
+        if (ref.format_length == 0) {
+            vs_logger::record_header_t header;
+            char encoded[vs_logger::max_ref_bytes];
+            if (!readRaw(ref.definition, &header, sizeof(header)) || !(header.sev & vs_logger::record_templated)) return false;
+            std::string_view definitionRef(encoded, std::min<size_t>(header.length, sizeof(encoded)));
+            vs_logger::template_ref_t definition;
+            if (!readRaw(ref.definition + sizeof(header), encoded, definitionRef.size()) ||
+                !vs_logger::decode_ref(definitionRef, definition) || definition.definition != ref.definition)
+                return false;
+            size_t refLength = definitionRef.data() - encoded;
+            if (refLength + definition.format_length > header.length) return false;
+            format.resize(definition.format_length);
+            if (!readRaw(ref.definition + sizeof(header) + refLength, format.data(), format.size())) return false;
+        }
+        auto parsed = vs_logger::format_template_t::parse(format);
+        if (!parsed) return false;
+        it = templates.emplace(ref.definition, std::move(*parsed)).first;
+    }
+
+    out.clear();
+    it->second.expand(out, raw.substr(ref.format_length));
+    return true;
+}
+
+// A record which does not have the lengths its index entry says is torn or corrupt.
+static bool matches(const Logger::log_entry_t &entry, const vs_logger::index_entry_t &item) {
+    return entry.length == item.length && entry.fields_length == item.fields_length;
+}
+
+bool LogReader::read(size_t pos, Logger::log_entry_t &entry, std::string &message) const {
+    vs_logger::index_entry_t item;
+    if (!index_at(pos, item)) return false;
+    return read_at(item.offset, entry, message) && matches(entry, item);
+}
+
+bool LogReader::read(size_t pos, Logger::log_entry_t &entry, std::string &message, std::string &fields) const {
+    vs_logger::index_entry_t item;
+    if (!index_at(pos, item)) return false;
+    return read_at(item.offset, entry, message, fields) && matches(entry, item);
+}
+
+bool LogReader::view(size_t pos, Logger::log_entry_t &entry, std::string_view &message) const {
+    std::string_view fields;
+    return view(pos, entry, message, fields);
+}
+
+bool LogReader::view(size_t pos, Logger::log_entry_t &entry, std::string_view &message, std::string_view &fields) const {
+    vs_logger::index_entry_t item;
+    if (compressed || !index_at(pos, item)) return false;
+    size_t end = item.offset + sizeof(vs_logger::record_header_t) + item.length + item.fields_length;
+
+    if (maps.empty() || maps.back().second < end) {
+        // The file grew past the current mapping: map it again at its current size.
+        struct stat st;
+        if (fstat(logFd, &st) < 0 || (size_t)st.st_size < end) return false;
+        void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, logFd, 0);
+        if (map == MAP_FAILED) return false;
+        maps.emplace_back((const char*)map, st.st_size);
+    }
+
+    // The mapping only covers what the index entry says, the header has to agree.
+    const char *base = maps.back().first;
+    vs_logger::record_header_t header;
+    memcpy(&header, base + item.offset, sizeof(header));
+    decode(header, item.offset, entry);
+    if (!matches(entry, item)) return false;
+    message = std::string_view(base + item.offset + sizeof(header), header.length);
+    fields = std::string_view(message.data() + message.size(), header.fields_length);
+    if (header.sev & vs_logger::record_templated) {
+        if (!expandTemplate(message, viewed)) return false;
+        message = viewed;
+    }
+    return true;
+}
+
+void LogReader::export_text(std::ostream &out, size_t from, size_t to) const {
+    Logger::log_entry_t entry;
+    std::string message, fields, line;
+    to = std::min(to, size());
+    for (size_t pos = from; pos < to; pos++) {
+        if (!read(pos, entry, message, fields)) break;
+        line.clear();
+        Logger::formatText(line, entry, message, fields);
+        out << line;
+    }
+}
+
+size_t LogReader::index_activities(size_t max_entries) const {
+    vs_logger::index_entry_t item;
+    vs_logger::record_header_t header;
+    size_t count = 0;
+    for (size_t end = size(); activitiesIndexed < end && count < max_entries; activitiesIndexed++, count++) {
+        if (!index_at(activitiesIndexed, item) || !readRaw(item.offset, &header, sizeof(header))) break;
+        activityEntries[header.activity_uuid].push_back(activitiesIndexed);
+        if (header.parent_uuid != 0 && header.parent_uuid != header.activity_uuid)
+            activityChildren[header.parent_uuid].insert(header.activity_uuid);
+    }
+    return count;
+}
+
+void LogReader::take_activities(LogReader &other) {
+    activitiesIndexed = std::exchange(other.activitiesIndexed, 0);
+    activityEntries = std::move(other.activityEntries);
+    activityChildren = std::move(other.activityChildren);
+    other.activityEntries.clear();
+    other.activityChildren.clear();
+}
+
+std::vector<size_t> LogReader::activity(uint64_t activity_uuid) const {
+    auto it = activityEntries.find(activity_uuid);
+    return it == activityEntries.end() ? std::vector<size_t>{} : it->second;
+}
+
+std::vector<uint64_t> LogReader::children(uint64_t parent_uuid) const {
+    auto it = activityChildren.find(parent_uuid);
+    return it == activityChildren.end() ? std::vector<uint64_t>{} : std::vector<uint64_t>(it->second.begin(), it->second.end());
+}
@@ -0,0 +1,1065 @@
+#ifndef LOG_HEADLESS
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <regex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <zlib.h>
+
+#include "vs-logger/archive.hpp"
+#include "vs-logger/logger.hpp"
+#include "vs-logger/metrics.hpp"
+#include "vs-logger/reader.hpp"
+#include "vs-logger/server.hpp"
+#include "vs-logger/shm_ring.hpp"
+#include "vs-logger/templates.hpp"
+#include "vs-logger/crow_all.h"
+#include "viewer.hpp"
+#include "ws_filter.hpp"
+
+#ifdef CROW_USE_BOOST
+namespace asio = boost::asio;
+#endif
+
+namespace {
+
+using vs_logger::for_each_line;
+using vs_logger::entry_seq;
+using vs_logger::ws_entry_t;
+using vs_logger::ws_filter_t;
+
+// Raw deflate stream of one client. The context is kept for the whole connection so every frame is
+// compressed against the entries sent before it, and each frame ends on a sync flush so the client
+// can inflate it completely as soon as it arrives.
+class ws_deflate_t {
+public:
+    explicit ws_deflate_t(int level) {
+        ok = deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+    ~ws_deflate_t() {
+        deflateEnd(&stream);
+    }
+    ws_deflate_t(const ws_deflate_t&) = delete;
+    ws_deflate_t& operator=(const ws_deflate_t&) = delete;
+
+    bool compress(std::string_view in, std::string& out) {
+        if (!ok) return false;
+        stream.next_in = (Bytef*)in.data();
+        stream.avail_in = in.size();
+        size_t used = 0;
+        out.resize(deflateBound(&stream, in.size()) + 16);
+        // The flush is complete once deflate leaves some of the output buffer unused.
+        for (;;) {
+            stream.next_out = (Bytef*)out.data() + used;
+            stream.avail_out = out.size() - used;
+            ok = deflate(&stream, Z_SYNC_FLUSH) == Z_OK;
+            used = out.size() - stream.avail_out;
+            if (!ok || stream.avail_out > 0) break;
+            out.resize(out.size() * 2);
+        }
+        out.resize(used);
+        return ok;
+    }
+
+private:
+    z_stream stream{};
+    bool ok;
+};
+
+// Counters of run_server(), served on "/metrics" with the state of every client.
+struct server_metrics_t {
+    std::atomic<uint64_t> entries{0};          // Entries received from producers.
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> dropped{0};          // Entries the bridge could not receive whole.
+    std::atomic<uint64_t> frames{0};           // WebSocket frames sent, and their bytes on the wire.
+    std::atomic<uint64_t> frameBytes{0};
+    std::atomic<uint64_t> sendFailures{0};
+    std::atomic<uint64_t> missed{0};           // Entries dropped from the queue of a lagging client.
+    std::atomic<uint64_t> nextClient{1};
+};
+
+// Delivery state of one WebSocket client. The bridge never waits on a client: entries are queued
+// here and sent as a single frame whenever the client has room for it, a client that falls behind
+// loses its oldest entries and is told how many with a {"missed":N} line.
+struct ws_client_t {
+    ws_client_t(crow::websocket::connection* conn, server_metrics_t& metrics)
+        : conn(conn), metrics(metrics), id(metrics.nextClient.fetch_add(1)) {}
+
+    // Queue a datagram of newline-terminated entries, dropping the oldest ones past limit entries.
+    // With a filter only the matching entries are queued, in a copy of their own.
+    void push(std::shared_ptr<const std::string> payload, size_t entries, size_t limit) {
+        if (!open) return;
+        if (filter) {
+            std::string selected;
+            try {
+                entries = filter->select(*payload, selected);
+                if (entries == 0) return;
+                payload = std::make_shared<const std::string>(std::move(selected));
+            } catch (const std::regex_error& ex) {
+                drop_filter(ex);
+            }
+        }
+        queue.emplace_back(std::move(payload), entries);
+        queued += entries;
+        while (queued > limit && queue.size() > 1) {
+            queued -= queue.front().second;
+            missed += queue.front().second;
+            missedTotal += queue.front().second;
+            metrics.missed.fetch_add(queue.front().second, std::memory_order_relaxed);
+            queue.pop_front();
+        }
+    }
+
+    // A filter the server failed to evaluate is dropped, the client gets every entry from then on.
+    void drop_filter(const std::exception& ex) {
+        std::cerr << "WebSocket: Dropped the filter of client " << id << ": " << ex.what() << std::endl;
+        filter = nullptr;
+    }
+
+    // Send everything queued as one frame unless the acknowledged window is full.
+    void drain(unsigned window) {
+        if (!open || queue.empty()) return;
+        if (acking && inflight >= window) return;
+        std::string frame;
+        frame.reserve(queued * 64);
+        if (missed) std::format_to(std::back_inserter(frame), "{{\"missed\":{}}}\n", missed);
+        for (const auto& [payload, entries] : queue) frame += *payload;
+        queue.clear();
+        queued = 0;
+        missed = 0;
+        send(std::move(frame));
+    }
+
+    // Send a frame right away, it still counts against the window.
+    void send(std::string frame) {
+        if (!open) return;
+        if (acking) inflight++;
+        try {
+            std::string packed;
+            size_t size = frame.size();
+            if (!deflate) conn->send_text(std::move(frame));
+            else if (deflate->compress(frame, packed)) {
+                size = packed.size();
+                conn->send_binary(std::move(packed));
+            }
+            else {
+                std::cerr << "Failed to deflate websocket frame" << std::endl;
+                metrics.sendFailures.fetch_add(1, std::memory_order_relaxed);
+                conn->close("deflate error");
+                open = false;
+                return;
+            }
+            metrics.frames.fetch_add(1, std::memory_order_relaxed);
+            metrics.frameBytes.fetch_add(size, std::memory_order_relaxed);
+        } catch (const std::exception& ex) {
+            metrics.sendFailures.fetch_add(1, std::memory_order_relaxed);
+            std::cerr << "Failed to send via websocket: " << ex.what() << std::endl;
+        }
+    }
+
+    crow::websocket::connection* conn;
+    server_metrics_t& metrics;
+    const uint64_t id;                            // Label of the client in "/metrics".
+    std::shared_ptr<const ws_filter_t> filter;   // Nullptr when the client gets everything.
+    std::unique_ptr<ws_deflate_t> deflate;        // Set once the client asked for binary deflated frames.
+    std::mutex mutex;   // Taken by the bridge and by the connection's own handlers only.
+    std::deque<std::pair<std::shared_ptr<const std::string>, size_t>> queue;
+    size_t queued = 0;
+    size_t missed = 0;
+    uint64_t missedTotal = 0;
+    unsigned inflight = 0;
+    bool acking = false;
+    bool open = true;
+};
+
+using ws_clients_t = std::vector<std::shared_ptr<ws_client_t>>;
+
+// The most recent datagrams, replayed to clients asking for what they missed. These are the same
+// shared buffers queued to the clients, so keeping them costs no copy.
+class history_t {
+public:
+    history_t(size_t max_entries, size_t max_bytes) : max_entries(max_entries), max_bytes(max_bytes) {}
+
+    void push(const std::shared_ptr<const std::string>& payload, size_t count) {
+        if (max_entries == 0 || max_bytes == 0) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        index(*payload, first + datagrams.size());
+        datagrams.emplace_back(payload, count);
+        entries += count;
+        bytes += payload->size();
+        while (datagrams.size() > 1 && (entries > max_entries || bytes > max_bytes)) {
+            unindex(*datagrams.front().first);
+            entries -= datagrams.front().second;
+            bytes -= datagrams.front().first->size();
+            datagrams.pop_front();
+            first++;
+        }
+    }
+
+    // Retained entries of an activity, and the activities whose entries have it as parent_uuid.
+    void activity(uint64_t activity_uuid, std::vector<std::string>& lines, std::vector<uint64_t>& children) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (auto it = activities.find(activity_uuid); it != activities.end()) {
+            for (const auto& posting : it->second) {
+                const auto& payload = *datagrams[posting.datagram - first].first;
+                lines.emplace_back(payload, posting.offset, posting.length);
+            }
+        }
+        if (auto it = parents.find(activity_uuid); it != parents.end())
+            for (const auto& [child, count] : it->second) children.push_back(child);
+    }
+
+    // Every retained entry with a seq_id above seq and matching filter (if any), as a single newline-delimited frame.
+    std::string since(uint64_t seq, const ws_filter_t* filter) const {
+        std::vector<std::shared_ptr<const std::string>> snapshot;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            snapshot.reserve(datagrams.size());
+            for (const auto& [payload, count] : datagrams) snapshot.push_back(payload);
+        }
+
+        std::string frame;
+        for (const auto& payload : snapshot) {
+            for_each_line(*payload, [&](std::string_view line) {
+                if (entry_seq(line) > seq && (!filter || filter->matches(line))) frame += line;
+            });
+        }
+        return frame;
+    }
+
+private:
+    // Where an entry sits in the retained datagrams, by absolute datagram number.
+    struct posting_t {
+        uint64_t datagram;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    void index(std::string_view datagram, uint64_t number) {
+        for_each_line(datagram, [&](std::string_view line) {
+            ws_entry_t entry(line);
+            activities[entry.activity_uuid].push_back({number, (uint32_t)(line.data() - datagram.data()), (uint32_t)line.size()});
+            if (entry.parent_uuid != 0 && entry.parent_uuid != entry.activity_uuid)
+                parents[entry.parent_uuid][entry.activity_uuid]++;
+        });
+    }
+
+    // Postings are appended in arrival order, so those of the oldest datagram are always at the front.
+    void unindex(std::string_view datagram) {
+        for_each_line(datagram, [&](std::string_view line) {
+            ws_entry_t entry(line);
+            auto it = activities.find(entry.activity_uuid);
+            it->second.pop_front();
+            if (it->second.empty()) activities.erase(it);
+            if (entry.parent_uuid != 0 && entry.parent_uuid != entry.activity_uuid) {
+                auto parent = parents.find(entry.parent_uuid);
+                if (--parent->second[entry.activity_uuid] == 0) parent->second.erase(entry.activity_uuid);
+                if (parent->second.empty()) parents.erase(parent);
+            }
+        });
+    }
+
+    const size_t max_entries;
+    const size_t max_bytes;
+    mutable std::mutex mutex;
+    std::deque<std::pair<std::shared_ptr<const std::string>, size_t>> datagrams;
+    uint64_t first = 0;     // Number of datagrams.front().
+    size_t entries = 0;
+    size_t bytes = 0;
+    std::unordered_map<uint64_t, std::deque<posting_t>> activities;
+    std::unordered_map<uint64_t, std::unordered_map<uint64_t, size_t>> parents;   // parent -> child -> entries
+};
+
+// Readers of the files of a BINARY log, oldest first.
+using log_readers_t = std::vector<const LogReader*>;
+
+// The files of a BINARY log: the retained segments "<file>.<n>" (or "<file>.<n>.z") then the live file.
+// refresh() follows the producer: after a rotation the reader of the live file goes on as the reader of
+// the newest segment, and the readers of segments compressed or deleted since are replaced or closed,
+// so no removed file is kept open. The activities indexed by a reader survive all of this.
+class log_files_t {
+public:
+    explicit log_files_t(std::optional<std::filesystem::path> path) : path(std::move(path)) {}
+
+    void refresh() {
+        if (!path) return;
+        std::unique_ptr<LogReader> rotated;
+        if (live && !live->same_file(*path)) rotated = std::move(live);
+
+        std::map<uint64_t, std::unique_ptr<LogReader>> current;
+        for (auto [n, compressed] : vs_logger::list_segments(*path)) {
+            if (current.contains(n)) continue;
+            auto plain = vs_logger::segment_path(*path, n), packed = plain;
+            packed += ".z";
+            auto it = segments.find(n);
+            if (it != segments.end() && (it->second->same_file(plain) || it->second->same_file(packed)))
+                current.emplace(n, std::move(it->second));
+            else if (rotated && rotated->same_file(plain))
+                current.emplace(n, std::move(rotated));
+            else if (auto reader = std::make_unique<LogReader>(plain); reader->is_open()) {
+                if (it != segments.end()) reader->take_activities(*it->second);
+                current.emplace(n, std::move(reader));
+            }
+        }
+        segments = std::move(current);
+
+        // The live file may not exist yet, or only for a moment be missing during a rotation.
+        if (!live && std::filesystem::exists(*path)) {
+            live = std::make_unique<LogReader>(*path);
+            if (!live->is_open()) live.reset();
+        }
+        readers.clear();
+        for (const auto& [n, reader] : segments) readers.push_back(reader.get());
+        if (live) readers.push_back(live.get());
+    }
+
+    // Valid until the next refresh().
+    const log_readers_t& all() const { return readers; }
+
+    // Index the activities of up to max_entries more entries, oldest files first, returns how many it indexed.
+    size_t index_activities(size_t max_entries) const {
+        size_t count = 0;
+        for (const auto* reader : readers) count += reader->index_activities(max_entries - count);
+        return count;
+    }
+
+private:
+    std::optional<std::filesystem::path> path;
+    std::map<uint64_t, std::unique_ptr<LogReader>> segments;
+    std::unique_ptr<LogReader> live;
+    log_readers_t readers;
+};
+
+// Append one activity of a tree to out, up to its still open children array: its entries from the log
+// files and the history, merged by seq_id. Sets children to the activities having it as parent.
+void activity_node(std::string& out, uint64_t uuid, const history_t& history, const log_readers_t& readers,
+                   std::vector<uint64_t>& children) {
+    std::map<uint64_t, std::string> entries;
+    std::set<uint64_t> childSet;
+
+    Logger::log_entry_t entry;
+    std::string message, fields;
+    for (const auto* reader : readers) {
+        for (size_t pos : reader->activity(uuid)) {
+            if (!reader->read(pos, entry, message, fields)) continue;
+            std::string line;
+            Logger::formatJson(line, entry, message, fields);
+            line.pop_back();
+            entries.emplace(entry.seq_id, std::move(line));
+        }
+        for (uint64_t child : reader->children(uuid)) childSet.insert(child);
+    }
+
+    std::vector<std::string> lines;
+    std::vector<uint64_t> retainedChildren;
+    history.activity(uuid, lines, retainedChildren);
+    for (auto& line : lines) {
+        uint64_t seq = entry_seq(line);
+        line.pop_back();
+        entries.emplace(seq, std::move(line));
+    }
+    childSet.insert(retainedChildren.begin(), retainedChildren.end());
+    children.assign(childSet.begin(), childSet.end());
+
+    std::format_to(std::back_inserter(out), "{{\"activity_uuid\":\"{}\",\"entries\":[", uuid);
+    bool first = true;
+    for (const auto& [seq, line] : entries) {
+        if (!first) out += ',';
+        out += line;
+        first = false;
+    }
+    out += "],\"children\":[";
+}
+
+// Append the tree of an activity to out: the activity, then the same for every activity having it as
+// parent. Activities already in the tree are skipped. Walked with an explicit stack, so a long parent chain
+// costs heap rather than the stack of the server thread.
+void activity_tree(std::string& out, uint64_t uuid, const history_t& history, const log_readers_t& readers) {
+    struct frame_t {
+        std::vector<uint64_t> children;
+        size_t next = 0;
+    };
+    std::unordered_set<uint64_t> visited{uuid};
+    std::vector<frame_t> stack(1);
+    activity_node(out, uuid, history, readers, stack.back().children);
+    while (!stack.empty()) {
+        auto& frame = stack.back();
+        while (frame.next < frame.children.size() && visited.contains(frame.children[frame.next])) frame.next++;
+        if (frame.next == frame.children.size()) {
+            out += "]}";
+            stack.pop_back();
+            continue;
+        }
+        if (out.back() != '[') out += ',';
+        uint64_t child = frame.children[frame.next++];
+        visited.insert(child);
+        // frame is not used past this point, emplace_back() may move it.
+        stack.emplace_back();
+        activity_node(out, child, history, readers, stack.back().children);
+    }
+}
+
+struct logs_query_t {
+    uint64_t from_ts = 0;
+    uint64_t to_ts = UINT64_MAX;
+    uint32_t type_mask = ~0u;
+    size_t limit = 1000;
+    std::optional<size_t> cursor;
+};
+
+// Comma-separated type names, as in "ERROR,PANIC".
+uint32_t parse_type_mask(std::string_view names) {
+    uint32_t mask = 0;
+    while (!names.empty()) {
+        size_t end = names.find(',');
+        auto name = names.substr(0, end);
+        names.remove_prefix(end == std::string_view::npos ? names.size() : end + 1);
+        int type = 0;
+        while (type <= (int)Logger::type_t::PANIC && to_string((Logger::type_t)type) != name) type++;
+        if (type > (int)Logger::type_t::PANIC) throw std::invalid_argument("unknown type " + std::string(name));
+        mask |= 1u << type;
+    }
+    return mask;
+}
+
+// Append one page of matching entries as {"entries":[...],"next_cursor":...} to out.
+// The start is found on the last index entry of each file, then by binary search on the index of the
+// first one reaching it. Entries are then read one at a time with pread(), going on with the next files,
+// so memory stays bounded by the page whatever the size of the log. A page also stops after scanning a
+// bounded number of entries, unreadable ones included, so sparse type filters cannot stall the server.
+// The cursor is the seq_id of the next entry to read, so it stays valid across rotations.
+void page_logs(std::string& out, const log_readers_t& readers, const logs_query_t& query) {
+    size_t file = 0, pos = 0;
+    vs_logger::index_entry_t item;
+    for (; file < readers.size(); file++) {
+        size_t size = readers[file]->size();
+        if (size == 0 || !readers[file]->index_at(size - 1, item)) continue;
+        if (query.cursor ? item.seq_id >= *query.cursor : item.timestamp >= query.from_ts) break;
+    }
+    if (file < readers.size())
+        pos = query.cursor ? readers[file]->lower_bound_seq(*query.cursor) : readers[file]->lower_bound(query.from_ts);
+    size_t budget = query.limit * 64;
+    size_t count = 0;
+    bool done = false;
+
+    Logger::log_entry_t entry;
+    std::string message, fields;
+    out += "{\"entries\":[";
+    while (file < readers.size() && count < query.limit && budget > 0) {
+        if (pos >= readers[file]->size()) {
+            file++;
+            pos = 0;
+            continue;
+        }
+        // A torn or corrupt record is skipped, rather than taken for the end of the log.
+        bool readable = readers[file]->read(pos, entry, message, fields);
+        if (readable && entry.timestamp > query.to_ts) {
+            done = true;
+            break;
+        }
+        pos++;
+        budget--;
+        if (!readable || entry.timestamp < query.from_ts || !(query.type_mask & (1u << (int)entry.type))) continue;
+        if (count++) out += ',';
+        Logger::formatJson(out, entry, message, fields);
+        out.pop_back();
+    }
+    while (!done && file < readers.size() && pos >= readers[file]->size()) {
+        file++;
+        pos = 0;
+    }
+    out += "],\"next_cursor\":";
+    if (done || file >= readers.size() || !readers[file]->index_at(pos, item)) out += "null}";
+    else std::format_to(std::back_inserter(out), "\"{}\"}}", item.seq_id);
+}
+
+// Entries of a producer writing to a shared memory ring (see shm_ring.hpp). The ring is read in place
+// on the thread of the UDS socket it was announced on, and its entries are formatted straight into the
+// datagram handed to broadcast, as if they had come from the socket.
+class shm_ingest {
+public:
+    using descriptor_t = asio::posix::stream_descriptor;
+
+    template<typename Executor>
+    shm_ingest(const Executor& executor, std::unique_ptr<vs_logger::shm_ring> ring, int pidFd,
+               const std::function<void(std::string_view)>& broadcast, std::function<void(shm_ingest*)> detach)
+        : ring(std::move(ring)), doorbell(executor, dup(this->ring->doorbell())), process(executor),
+          broadcast(broadcast), detach(std::move(detach)) {
+        if (pidFd >= 0) process.assign(pidFd);
+    }
+
+    uint64_t token() const { return ring->token(); }
+
+    void start() {
+        // The process went away without closing the ring, whatever it published is still drained.
+        if (process.is_open()) {
+            process.async_wait(descriptor_t::wait_read, [this](const crow::error_code& ec) {
+                if (ec) return;
+                exited = true;
+                drain();
+            });
+        }
+        drain();
+    }
+
+private:
+    void arm() {
+        if (waiting) return;
+        waiting = true;
+        doorbell.async_wait(descriptor_t::wait_read, [this](const crow::error_code& ec) {
+            if (ec == asio::error::operation_aborted) return;
+            waiting = false;
+            if (ec) std::cerr << "UDS Bridge: Doorbell wait failed: " << ec.message() << std::endl;
+            ring->clear_doorbell();
+            drain();
+        });
+    }
+
+    void drain() {
+        if (detached) return;
+        // A busy ring is read in bounded rounds, so the other producers of the thread get their turn.
+        for (unsigned round = 0; round < 16 && !ring->empty(); round++) {
+            batch.clear();
+            size_t count = ring->consume([this](const vs_logger::record_header_t& record, std::string_view message,
+                                                std::string_view fields) {
+                // Fragments of a large entry are joined back (see record_continued).
+                if (record.seq_id != pendingSeq) {
+                    pendingMessage.clear();
+                    pendingFields.clear();
+                }
+                if (record.sev & vs_logger::record_continued) {
+                    pendingSeq = record.seq_id;
+                    pendingMessage += message;
+                    pendingFields += fields;
+                    return;
+                }
+                if (!pendingMessage.empty() || !pendingFields.empty()) {
+                    pendingMessage += message;
+                    pendingFields += fields;
+                    message = pendingMessage;
+                    fields = pendingFields;
+                }
+                Logger::log_entry_t entry{};
+                entry.type = (Logger::type_t)record.type;
+                entry.sev = (Logger::severity_t)(record.sev & ~vs_logger::record_templated);
+                entry.timestamp = record.timestamp;
+                entry.activity_uuid = record.activity_uuid;
+                entry.seq_id = record.seq_id;
+                entry.parent_uuid = record.parent_uuid;
+                entry.length = message.size();
+                entry.fields_length = fields.size();
+                if (record.sev & vs_logger::record_templated) message = expand(message);
+                Logger::formatJson(batch, entry, message, fields);
+                pendingMessage.clear();
+                pendingFields.clear();
+            }, BATCH_ENTRIES);
+            if (count && !batch.empty()) broadcast(batch);
+        }
+        if (uint64_t dropped = ring->dropped(); dropped != reportedDropped) {
+            std::cerr << "UDS Bridge: A producer dropped " << dropped - reportedDropped << " entries, its shared memory ring was full" << std::endl;
+            reportedDropped = dropped;
+        }
+        if (!ring->empty()) {
+            asio::post(doorbell.get_executor(), [this]() { drain(); });
+            return;
+        }
+        if (exited || ring->closed()) {
+            detached = true;
+            auto* self = this;
+            asio::post(doorbell.get_executor(), [self, detach = detach]() { detach(self); });
+            return;
+        }
+        if (ring->sleep()) arm();
+        else asio::post(doorbell.get_executor(), [this]() { drain(); });
+    }
+
+    // Text of a templated record, the format string coming with the first entry of each template.
+    std::string_view expand(std::string_view raw) {
+        vs_logger::template_ref_t ref;
+        if (!vs_logger::decode_ref(raw, ref) || raw.size() < ref.format_length) return {};
+        if (ref.format_length > 0) {
+            if (auto parsed = vs_logger::format_template_t::parse(raw.substr(0, ref.format_length)))
+                templates.insert_or_assign(ref.id, std::move(*parsed));
+        }
+        expanded.clear();
+        auto it = templates.find(ref.id);
+        if (it == templates.end()) expanded = "<unknown format " + std::to_string(ref.id) + ">";
+        else it->second.expand(expanded, raw.substr(ref.format_length));
+        return expanded;
+    }
+
+    static constexpr size_t BATCH_ENTRIES = 256;
+
+    std::unique_ptr<vs_logger::shm_ring> ring;
+    descriptor_t doorbell;   // A duplicate of the ring's eventfd, owned by asio.
+    descriptor_t process;    // pidfd of the producer, if it sent one.
+    const std::function<void(std::string_view)>& broadcast;
+    std::function<void(shm_ingest*)> detach;
+    std::string batch;
+    std::unordered_map<uint64_t, vs_logger::format_template_t> templates;   // By id of the producer.
+    std::string expanded;
+    std::string pendingMessage, pendingFields;   // Fragments read so far of the entry pendingSeq.
+    uint64_t pendingSeq = 0;
+    uint64_t reportedDropped = 0;
+    bool waiting = false;
+    bool exited = false;
+    bool detached = false;
+};
+
+// Receives the datagrams written by the logger on the UDS socket.
+// The socket is registered with an asio reactor: every readiness wakeup drains it with recvmmsg
+// until it would block, then the wait is armed again, so an idle bridge costs nothing.
+class uds_ingest {
+public:
+    using socket_t = asio::local::datagram_protocol::socket;
+
+    template<typename F>
+    uds_ingest(socket_t&& sock, F&& broadcast, server_metrics_t& metrics)
+        : sock(std::move(sock)), broadcast(std::forward<F>(broadcast)), metrics(metrics), buffers(BATCH * BUFFER_SIZE) {
+        for (unsigned i = 0; i < BATCH; i++) {
+            iov[i].iov_base = buffers.data() + i * BUFFER_SIZE;
+            iov[i].iov_len = BUFFER_SIZE;
+        }
+    }
+
+    void arm() {
+        sock.async_wait(socket_t::wait_read, [this](const crow::error_code& ec) {
+            if (ec) {
+                if (ec != asio::error::operation_aborted)
+                    std::cerr << "UDS Bridge: Wait failed: " << ec.message() << std::endl;
+                return;
+            }
+            drain();
+            arm();
+        });
+    }
+
+private:
+    void drain() {
+        for (;;) {
+            for (unsigned i = 0; i < BATCH; i++) {
+                memset(&msgs[i], 0, sizeof(msgs[i]));
+                msgs[i].msg_hdr.msg_name = &peers[i];
+                msgs[i].msg_hdr.msg_namelen = sizeof(peers[i]);
+                msgs[i].msg_hdr.msg_iov = &iov[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+                msgs[i].msg_hdr.msg_control = controls[i];
+                msgs[i].msg_hdr.msg_controllen = sizeof(controls[i]);
+            }
+            int n = recvmmsg(sock.native_handle(), msgs, BATCH, MSG_DONTWAIT, nullptr);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    std::cerr << "UDS Bridge: Failed to receive: " << strerror(errno) << std::endl;
+                return;
+            }
+            for (int i = 0; i < n; i++) {
+                if (msgs[i].msg_hdr.msg_controllen > 0) {
+                    handshake(msgs[i].msg_hdr, std::string_view(buffers.data() + i * BUFFER_SIZE, msgs[i].msg_len));
+                    continue;
+                }
+                if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                    metrics.dropped.fetch_add(1, std::memory_order_relaxed);
+                    std::cerr << "UDS Bridge: Dropped a datagram larger than " << BUFFER_SIZE << " bytes" << std::endl;
+                    continue;
+                }
+                receive(peer_name(peers[i], msgs[i].msg_hdr.msg_namelen),
+                        std::string_view(buffers.data() + i * BUFFER_SIZE, msgs[i].msg_len));
+            }
+        }
+    }
+
+    // A datagram not ending with a newline is continued by the next ones of the same sender, until one
+    // of them does. Complete datagrams, by far the most common, are broadcast from the receive buffer.
+    void receive(std::string_view sender, std::string_view datagram) {
+        bool complete = !datagram.empty() && datagram.back() == '\n';
+        if (complete && partials.empty()) return broadcast(datagram);
+
+        auto it = partials.find(sender);
+        if (it == partials.end()) {
+            if (complete) broadcast(datagram);
+            else partials.emplace(sender, partial_t{std::string(datagram)});
+            return;
+        }
+        auto& partial = it->second;
+        // Past the limit the rest of the entry is skipped, up to its newline.
+        if (partial.overflow) {
+            size_t end = datagram.find('\n');
+            if (end == std::string_view::npos) return;
+            partials.erase(it);
+            if (end + 1 < datagram.size()) receive(sender, datagram.substr(end + 1));
+            return;
+        }
+        partial.data += datagram;
+        if (complete) {
+            broadcast(partial.data);
+            partials.erase(it);
+        }
+        else if (partial.data.size() > MAX_ENTRY_SIZE) {
+            metrics.dropped.fetch_add(1, std::memory_order_relaxed);
+            std::cerr << "UDS Bridge: Dropped an entry larger than " << MAX_ENTRY_SIZE << " bytes" << std::endl;
+            partial.overflow = true;
+            partial.data = std::string();
+        }
+    }
+
+    // A producer handing over its shared memory ring: memfd, doorbell and optionally its pidfd.
+    // Rings are announced again when they stay full, those already attached are ignored.
+    void handshake(const struct msghdr& hdr, std::string_view datagram) {
+        std::vector<int> fds;
+        for (auto* cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(const_cast<struct msghdr*>(&hdr), cmsg)) {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+            size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            size_t first = fds.size();
+            fds.resize(first + count);
+            memcpy(fds.data() + first, CMSG_DATA(cmsg), count * sizeof(int));
+        }
+        if (datagram != std::string_view(&vs_logger::shm_handshake, 1) || fds.size() < 2 || fds.size() > 3) {
+            for (int fd : fds) close(fd);
+            return;
+        }
+        int pidFd = fds.size() > 2 ? fds[2] : -1;
+        auto ring = vs_logger::shm_ring::attach(fds[0], fds[1]);
+        if (!ring || std::any_of(rings.begin(), rings.end(), [&](const auto& r) { return r->token() == ring->token(); })) {
+            if (pidFd >= 0) close(pidFd);
+            return;
+        }
+        auto& ingest = rings.emplace_back(std::make_unique<shm_ingest>(sock.get_executor(), std::move(ring), pidFd, broadcast,
+            [this](shm_ingest* done) {
+                std::erase_if(rings, [done](const auto& r) { return r.get() == done; });
+                std::cout << "UDS Bridge: Shared memory ring detached" << std::endl;
+            }));
+        std::cout << "UDS Bridge: Shared memory ring attached" << std::endl;
+        ingest->start();
+    }
+
+    // Producers autobind to an abstract address, unbound senders all share the empty name.
+    static std::string_view peer_name(const sockaddr_un& peer, socklen_t length) {
+        size_t offset = offsetof(sockaddr_un, sun_path);
+        return length > offset ? std::string_view(peer.sun_path, length - offset) : std::string_view();
+    }
+
+    // Each datagram holds one or more newline-terminated entries, or a fragment of a larger one.
+    static constexpr size_t BUFFER_SIZE = 64 * 1024;
+    static constexpr size_t MAX_ENTRY_SIZE = 64 * 1024 * 1024;
+    static constexpr unsigned BATCH = 16;
+
+    struct partial_t {
+        std::string data;
+        bool overflow = false;
+    };
+
+    socket_t sock;
+    std::function<void(std::string_view)> broadcast;
+    server_metrics_t& metrics;
+    std::vector<char> buffers;
+    struct iovec iov[BATCH];
+    struct sockaddr_un peers[BATCH];
+    alignas(struct cmsghdr) char controls[BATCH][CMSG_SPACE(3 * sizeof(int))];
+    struct mmsghdr msgs[BATCH];
+    std::map<std::string, partial_t, std::less<>> partials;   // Entries being joined, by sender.
+    std::list<std::unique_ptr<shm_ingest>> rings;              // Attached shared memory rings.
+};
+
+// Bind a non-blocking datagram socket at path, replacing any previous socket file.
+bool bind_uds(uds_ingest::socket_t& sock, const std::filesystem::path& path) {
+    crow::error_code ec;
+    unlink(path.c_str());
+    sock.open(asio::local::datagram_protocol(), ec);
+    if (!ec) sock.bind(asio::local::datagram_protocol::endpoint(path.string()), ec);
+    if (!ec) sock.non_blocking(true, ec);
+    if (ec) {
+        std::cerr << "UDS Bridge: Failed to bind " << path << ": " << ec.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+}
+
+void vs_logger::run_server(const std::vector<std::filesystem::path>& udsPaths, uint16_t port, const Logger::config_t& config,
+                           const std::optional<std::filesystem::path>& logFilePath,
+                           const std::function<void(std::string&)>& producerMetrics) {
+    // Start Crow application.
+    crow::SimpleApp app;
+
+    // Active WebSocket clients, replaced as a whole on open/close so the bridge reads it without locking.
+    std::atomic<std::shared_ptr<const ws_clients_t>> wsClients{std::make_shared<const ws_clients_t>()};
+    std::mutex wsClientsMutex;
+    history_t history(config.ws_history_entries, config.ws_history_bytes);
+    server_metrics_t metrics;
+
+    // Serve the webpage.
+    CROW_ROUTE(app, "/")
+    ([]() -> const char* {
+        return viewer_html;
+    });
+
+    // The log file may not exist yet when the server starts, and the producer rotates it at any time:
+    // the readers are brought up to date on every request.
+    log_files_t logFiles(logFilePath);
+    std::mutex readerMutex;
+
+    // Activities of the log files are indexed on a thread of their own, in rounds short enough not to hold
+    // up /logs, so /activity only looks them up. Entries not indexed yet are still in the history.
+    std::atomic<bool> indexerStopping{false};
+    std::condition_variable indexerCv;
+    std::thread indexer;
+    if (logFilePath) {
+        indexer = std::thread([&]() {
+            constexpr size_t ROUND_ENTRIES = 4096;
+            std::unique_lock<std::mutex> lock(readerMutex);
+            while (!indexerStopping) {
+                logFiles.refresh();
+                if (logFiles.index_activities(ROUND_ENTRIES) == ROUND_ENTRIES) {
+                    lock.unlock();
+                    std::this_thread::yield();
+                    lock.lock();
+                }
+                else indexerCv.wait_for(lock, std::chrono::milliseconds(100), [&]() { return indexerStopping.load(); });
+            }
+        });
+    }
+
+    // Page of stored entries: /logs?from_ts=&to_ts=&type=ERROR,PANIC&limit=&cursor=
+    // Both timestamps are inclusive, cursor is the next_cursor of the previous page.
+    CROW_ROUTE(app, "/logs")
+    ([&](const crow::request& req) {
+        std::lock_guard<std::mutex> lock(readerMutex);
+        logFiles.refresh();
+        if (logFiles.all().empty()) return crow::response(404, "No binary log file available");
+
+        logs_query_t query;
+        try {
+            if (auto value = req.url_params.get("from_ts")) query.from_ts = std::stoull(value);
+            if (auto value = req.url_params.get("to_ts")) query.to_ts = std::stoull(value);
+            if (auto value = req.url_params.get("limit")) query.limit = std::clamp<size_t>(std::stoull(value), 1, 10000);
+            if (auto value = req.url_params.get("cursor")) query.cursor = std::stoull(value);
+            if (auto value = req.url_params.get("type")) query.type_mask = parse_type_mask(value);
+        } catch (const std::exception& ex) {
+            return crow::response(400, std::string("Invalid query: ") + ex.what());
+        }
+
+        std::string body;
+        page_logs(body, logFiles.all(), query);
+        crow::response res(std::move(body));
+        res.set_header("Content-Type", "application/json");
+        return res;
+    });
+
+    // Full tree of an activity, as {"activity_uuid", "entries", "children"} objects.
+    CROW_ROUTE(app, "/activity/<uint>")
+    ([&](uint64_t uuid) {
+        std::lock_guard<std::mutex> lock(readerMutex);
+        logFiles.refresh();
+        std::string body;
+        activity_tree(body, uuid, history, logFiles.all());
+        crow::response res(std::move(body));
+        res.set_header("Content-Type", "application/json");
+        return res;
+    });
+
+    // Prometheus text format: the server, each of its clients, then the producer it runs in if any.
+    CROW_ROUTE(app, "/metrics")
+    ([&]() {
+        std::string body;
+        auto counter = [&](std::string_view name, std::string_view help, const std::atomic<uint64_t>& value) {
+            vs_logger::prometheus_metric(body, name, "counter", help, value.load(std::memory_order_relaxed));
+        };
+        counter("vs_logger_server_entries_total", "Entries received from producers.", metrics.entries);
+        counter("vs_logger_server_bytes_total", "Bytes of entries received from producers.", metrics.bytes);
+        counter("vs_logger_server_dropped_entries_total", "Entries too large to be received.", metrics.dropped);
+        counter("vs_logger_server_ws_frames_total", "WebSocket frames sent.", metrics.frames);
+        counter("vs_logger_server_ws_bytes_total", "WebSocket payload bytes sent, after compression.", metrics.frameBytes);
+        counter("vs_logger_server_ws_send_failures_total", "WebSocket frames which could not be sent.", metrics.sendFailures);
+        counter("vs_logger_server_ws_missed_entries_total", "Entries dropped from the queues of lagging clients.", metrics.missed);
+
+        auto clients = wsClients.load();
+        vs_logger::prometheus_metric(body, "vs_logger_server_ws_clients", "gauge", "Connected WebSocket clients.", clients->size());
+        struct lag_t {
+            std::string labels;
+            uint64_t queued, inflight, missed;
+        };
+        std::vector<lag_t> lags;
+        for (const auto& client : *clients) {
+            std::lock_guard<std::mutex> lock(client->mutex);
+            lags.push_back({std::format("client=\"{}\"", client->id), client->queued, client->inflight, client->missedTotal});
+        }
+        auto perClient = [&](std::string_view name, std::string_view type, std::string_view help, uint64_t lag_t::*field) {
+            vs_logger::prometheus_header(body, name, type, help);
+            for (const auto& lag : lags) vs_logger::prometheus_sample(body, name, lag.labels, lag.*field);
+        };
+        perClient("vs_logger_server_ws_client_queued_entries", "gauge", "Entries waiting to be sent to a client.", &lag_t::queued);
+        perClient("vs_logger_server_ws_client_inflight_frames", "gauge", "Frames sent to a client and not acknowledged yet.", &lag_t::inflight);
+        perClient("vs_logger_server_ws_client_missed_entries_total", "counter", "Entries a client lost by falling behind.", &lag_t::missed);
+
+        if (producerMetrics) producerMetrics(body);
+        crow::response res(std::move(body));
+        res.set_header("Content-Type", "text/plain; version=0.0.4");
+        return res;
+    });
+
+    // WebSocket endpoint.
+    CROW_WEBSOCKET_ROUTE(app, "/ws")
+    .onopen([&wsClients, &wsClientsMutex, &metrics](crow::websocket::connection& conn) {
+        auto client = std::make_shared<ws_client_t>(&conn, metrics);
+        conn.userdata(client.get());
+        std::lock_guard<std::mutex> lock(wsClientsMutex);
+        auto clients = std::make_shared<ws_clients_t>(*wsClients.load());
+        clients->push_back(std::move(client));
+        wsClients.store(std::move(clients));
+        std::cout << "WebSocket connection opened" << std::endl;
+    })
+    .onclose([&wsClients, &wsClientsMutex](crow::websocket::connection& conn, const std::string& reason, uint16_t) {
+        auto* client = static_cast<ws_client_t*>(conn.userdata());
+        {
+            std::lock_guard<std::mutex> lock(client->mutex);
+            client->open = false;
+        }
+        std::lock_guard<std::mutex> lock(wsClientsMutex);
+        auto clients = std::make_shared<ws_clients_t>(*wsClients.load());
+        std::erase_if(*clients, [client](const auto& c) { return c.get() == client; });
+        wsClients.store(std::move(clients));
+        std::cout << "WebSocket connection closed: " << reason << std::endl;
+    })
+    .onmessage([&config, &history](crow::websocket::connection& conn, const std::string& data, bool /*is_binary*/) {
+        // Clients that acknowledge frames get flow control.
+        auto* client = static_cast<ws_client_t*>(conn.userdata());
+        std::string_view command = data;
+        if (command == "ack") {
+            std::lock_guard<std::mutex> lock(client->mutex);
+            client->acking = true;
+            if (client->inflight > 0) client->inflight--;
+            client->drain(config.ws_client_window);
+        }
+        // "since <seq_id>" replays the retained entries after seq_id as one frame.
+        else if (command.starts_with("since ")) {
+            uint64_t seq = 0;
+            command.remove_prefix(6);
+            std::from_chars(command.data(), command.data() + command.size(), seq);
+            std::shared_ptr<const ws_filter_t> filter;
+            {
+                std::lock_guard<std::mutex> lock(client->mutex);
+                filter = client->filter;
+            }
+            std::string frame;
+            try {
+                frame = history.since(seq, filter.get());
+            } catch (const std::regex_error& ex) {
+                {
+                    std::lock_guard<std::mutex> lock(client->mutex);
+                    if (client->filter == filter) client->drop_filter(ex);
+                }
+                frame = history.since(seq, nullptr);
+            }
+            if (frame.empty()) return;
+            std::lock_guard<std::mutex> lock(client->mutex);
+            client->send(std::move(frame));
+        }
+        // "deflate" switches the rest of the connection to binary frames holding one raw deflate stream.
+        else if (command == "deflate") {
+            if (config.ws_deflate_level <= 0) return;
+            std::lock_guard<std::mutex> lock(client->mutex);
+            if (!client->deflate) client->deflate = std::make_unique<ws_deflate_t>(config.ws_deflate_level);
+        }
+        // "filter {...}" replaces the subscription of the client, "filter {}" clears it.
+        else if (command.starts_with("filter ")) {
+            command.remove_prefix(7);
+            auto filter = ws_filter_t::parse(command);
+            std::lock_guard<std::mutex> lock(client->mutex);
+            client->filter = std::move(filter);
+        }
+    });
+
+    auto server = app.port(port).concurrency(config.server_threads).run_async();
+
+    // Each datagram is stored once and shared by the queues of all connected clients.
+    auto broadcast = [&config, &wsClients, &history, &metrics](std::string_view datagram) {
+        size_t entries = std::count(datagram.begin(), datagram.end(), '\n');
+        if (entries == 0) return;
+        metrics.entries.fetch_add(entries, std::memory_order_relaxed);
+        metrics.bytes.fetch_add(datagram.size(), std::memory_order_relaxed);
+        auto payload = std::make_shared<const std::string>(datagram);
+        history.push(payload, entries);
+        auto clients = wsClients.load();
+        for (const auto& client : *clients) {
+            std::lock_guard<std::mutex> lock(client->mutex);
+            client->push(payload, entries, config.ws_client_queue);
+            client->drain(config.ws_client_window);
+        }
+    };
+
+    // One UDS listener per socket and shard, each driven by its own reactor and thread.
+    // A shard is only ever read by one thread, so entries of one activity keep their order.
+    unsigned shards = std::max(config.uds_shards, 1u);
+    std::deque<asio::io_context> ingestContexts;
+    std::deque<uds_ingest> ingests;
+    for (const auto& udsPath : udsPaths) {
+        for (unsigned i = 0; i < shards; i++) {
+            auto& context = ingestContexts.emplace_back();
+            uds_ingest::socket_t sock(context);
+            if (bind_uds(sock, Logger::uds_shard_path(udsPath, i)))
+                ingests.emplace_back(std::move(sock), broadcast, metrics).arm();
+        }
+    }
+    std::vector<std::thread> ingestThreads;
+    for (auto& context : ingestContexts)
+        ingestThreads.emplace_back([&context]() { context.run(); });
+
+    // Crow stops on SIGINT/SIGTERM, the listeners go down with it.
+    server.wait();
+    for (auto& context : ingestContexts) context.stop();
+    for (auto& thread : ingestThreads) thread.join();
+    if (indexer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(readerMutex);
+            indexerStopping = true;
+        }
+        indexerCv.notify_one();
+        indexer.join();
+    }
+}
+
+void Logger::start_server(uint16_t port) {
+    if(udsPath.has_value()){
+        // Start the web server (which will act as the UDS listener as well).
+        // Activities are also looked up in the log file and its segments when they can be read back.
+        std::optional<std::filesystem::path> readablePath;
+        if (config.file_format == format_t::BINARY)
+            readablePath = logFilePath;
+        // The counters are shared, the server thread never stops and may outlive this Logger.
+        webServerThread = std::thread([udsPaths = std::vector{*udsPath}, port, config = config, readablePath, counters = counters]() {
+            vs_logger::run_server(udsPaths, port, config, readablePath, [counters](std::string& out) {
+                vs_logger::write_prometheus(out, counters->snapshot());
+            });
+        });
+
+        // Detach the web server thread so it runs in the background.
+        webServerThread.detach();
+    }
+}
+
+#endif
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <random>
+#include <thread>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "vs-logger/shm_ring.hpp"
+
+std::unique_ptr<vs_logger::shm_ring> vs_logger::shm_ring::create(size_t capacity) {
+    capacity = std::bit_ceil(std::max<size_t>(capacity, 64 * 1024));
+    size_t mappedSize = sizeof(shm_header_t) + capacity;
+
+    int memFd = memfd_create("vs-logger", MFD_CLOEXEC);
+    if (memFd < 0 || ftruncate(memFd, mappedSize) < 0) {
+        std::cerr << "Failed to create shared memory ring: " << strerror(errno) << std::endl;
+        if (memFd >= 0) ::close(memFd);
+        return nullptr;
+    }
+    void *map = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, memFd, 0);
+    int doorbellFd = map == MAP_FAILED ? -1 : eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (doorbellFd < 0) {
+        std::cerr << "Failed to map shared memory ring: " << strerror(errno) << std::endl;
+        if (map != MAP_FAILED) munmap(map, mappedSize);
+        ::close(memFd);
+        return nullptr;
+    }
+
+    // The memfd starts zeroed, only the constant fields need to be set.
+    auto *header = new (map) shm_header_t{};
+    memcpy(header->magic, shm_magic, sizeof(header->magic));
+    header->token = std::random_device{}() ^ ((uint64_t)getpid() << 32) ^ (uint64_t)(uintptr_t)map;
+    header->capacity = capacity;
+    return std::unique_ptr<shm_ring>(new shm_ring(memFd, doorbellFd, header, mappedSize));
+}
+
+std::unique_ptr<vs_logger::shm_ring> vs_logger::shm_ring::attach(int memFd, int doorbellFd) {
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(memFd, &st) == 0 && (size_t)st.st_size > sizeof(shm_header_t))
+        map = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, memFd, 0);
+    auto *header = (shm_header_t*)map;
+    if (map == MAP_FAILED || memcmp(header->magic, shm_magic, sizeof(header->magic)) != 0 ||
+        !std::has_single_bit(header->capacity) || sizeof(shm_header_t) + header->capacity > (size_t)st.st_size) {
+        std::cerr << "Not a shared memory log ring" << std::endl;
+        if (map != MAP_FAILED) munmap(map, st.st_size);
+        ::close(memFd);
+        ::close(doorbellFd);
+        return nullptr;
+    }
+    return std::unique_ptr<shm_ring>(new shm_ring(memFd, doorbellFd, header, st.st_size));
+}
+
+vs_logger::shm_ring::shm_ring(int memFd, int doorbellFd, shm_header_t *header, size_t mappedSize)
+    : memFd(memFd), doorbellFd(doorbellFd), header(header), data((char*)(header + 1)),
+      mappedSize(mappedSize), mask(header->capacity - 1) {
+    writePos = header->head.load(std::memory_order_relaxed);
+    cachedTail = header->tail.load(std::memory_order_relaxed);
+}
+
+vs_logger::shm_ring::~shm_ring() {
+    munmap(header, mappedSize);
+    ::close(memFd);
+    ::close(doorbellFd);
+}
+
+bool vs_logger::shm_ring::push(const record_header_t &record, std::string_view message, std::string_view fields) {
+    size_t size = padded(sizeof(record_header_t) + message.size() + fields.size());
+    size_t offset = writePos & mask;
+    // Records never wrap: skip the end of the ring if the record does not fit before it.
+    size_t skip = offset + size > header->capacity ? header->capacity - offset : 0;
+    if (!reserve(writePos + skip + size)) {
+        header->dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (skip) {
+        ((record_header_t*)(data + offset))->type = shm_skip;
+        writePos += skip;
+        offset = 0;
+    }
+    memcpy(data + offset, &record, sizeof(record));
+    memcpy(data + offset + sizeof(record), message.data(), message.size());
+    memcpy(data + offset + sizeof(record) + message.size(), fields.data(), fields.size());
+    writePos += size;
+    return true;
+}
+
+bool vs_logger::shm_ring::reserve(uint64_t end) {
+    if (end - cachedTail <= header->capacity) return true;
+    cachedTail = header->tail.load(std::memory_order_acquire);
+    if (end - cachedTail <= header->capacity) return true;
+    if (stalled && cachedTail == stalledTail) return false;
+
+    // Wait for as long as the server keeps consuming, the way a full socket would block. Once it stops
+    // for stall_timeout every push fails right away, until it moves again.
+    publish();
+    auto deadline = std::chrono::steady_clock::now() + stall_timeout;
+    for (uint64_t last = cachedTail;;) {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+        cachedTail = header->tail.load(std::memory_order_acquire);
+        if (end - cachedTail <= header->capacity) {
+            stalled = false;
+            return true;
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (cachedTail != last) {
+            last = cachedTail;
+            deadline = now + stall_timeout;
+        }
+        else if (now >= deadline) {
+            stalled = true;
+            stalledTail = cachedTail;
+            return false;
+        }
+    }
+}
+
+void vs_logger::shm_ring::publish() {
+    if (header->head.load(std::memory_order_relaxed) == writePos) return;
+    header->head.store(writePos, std::memory_order_seq_cst);
+    // Pairs with sleep(): either the server sees the new head, or we see it sleeping.
+    if (header->sleeping.load(std::memory_order_seq_cst) && header->sleeping.exchange(0)) {
+        uint64_t one = 1;
+        [[maybe_unused]] auto ret = ::write(doorbellFd, &one, sizeof(one));
+    }
+}
+
+void vs_logger::shm_ring::close() {
+    publish();
+    header->closed.store(1, std::memory_order_release);
+    uint64_t one = 1;
+    [[maybe_unused]] auto ret = ::write(doorbellFd, &one, sizeof(one));
+}
+
+bool vs_logger::shm_ring::sleep() {
+    header->sleeping.store(1, std::memory_order_seq_cst);
+    if (header->head.load(std::memory_order_seq_cst) != header->tail.load(std::memory_order_relaxed) || closed()) {
+        header->sleeping.store(0, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void vs_logger::shm_ring::clear_doorbell() {
+    uint64_t value;
+    [[maybe_unused]] auto ret = ::read(doorbellFd, &value, sizeof(value));
+}
@@ -0,0 +1,196 @@
+#include <charconv>
+#include <deque>
+#include <format>
+#include <iterator>
+#include <mutex>
+#include <unordered_map>
+
+#include "vs-logger/fields.hpp"
+#include "vs-logger/templates.hpp"
+
+std::optional<vs_logger::format_template_t> vs_logger::format_template_t::parse(std::string_view format) {
+    format_template_t result;
+    result.text = format;
+    std::string literal;
+    int next = 0;
+    bool manual = false, automatic = false;
+    for (size_t i = 0; i < format.size(); i++) {
+        char c = format[i];
+        if (c == '}') {
+            if (i + 1 == format.size() || format[i + 1] != '}') return std::nullopt;
+            literal += '}';
+            i++;
+            continue;
+        }
+        if (c != '{') {
+            literal += c;
+            continue;
+        }
+        if (i + 1 < format.size() && format[i + 1] == '{') {
+            literal += '{';
+            i++;
+            continue;
+        }
+
+        size_t end = format.find('}', i);
+        if (end == std::string_view::npos) return std::nullopt;
+        std::string_view field = format.substr(i + 1, end - i - 1);
+        if (field.find('{') != std::string_view::npos) return std::nullopt;
+        size_t colon = field.find(':');
+        std::string_view id = field.substr(0, colon);
+        int arg;
+        if (id.empty()) {
+            if (manual) return std::nullopt;
+            automatic = true;
+            arg = next++;
+        }
+        else {
+            if (automatic) return std::nullopt;
+            manual = true;
+            auto [ptr, ec] = std::from_chars(id.data(), id.data() + id.size(), arg);
+            if (ec != std::errc() || ptr != id.data() + id.size()) return std::nullopt;
+        }
+
+        std::string spec;
+        if (colon != std::string_view::npos && colon + 1 < field.size()) spec = "{" + std::string(field.substr(colon)) + "}";
+        result.segments.push_back({std::move(literal), arg, std::move(spec)});
+        literal.clear();
+        i = end;
+    }
+    result.segments.push_back({std::move(literal), -1, {}});
+    return result;
+}
+
+// Render value with a std::format spec, as a value of its original type would be.
+template<typename T>
+static bool formatSpec(std::string &out, const std::string &spec, T value) {
+    try {
+        std::vformat_to(std::back_inserter(out), spec, std::make_format_args(value));
+        return true;
+    } catch (const std::exception &) {
+        out += spec;
+        return false;
+    }
+}
+
+bool vs_logger::format_template_t::expand(std::string &out, std::string_view args) const {
+    // Reused, so rendering does not allocate once warmed up.
+    static thread_local std::vector<field_t> values;
+    values.clear();
+    bool ok = for_each_field(args, [](const field_t &field) { values.push_back(field); });
+
+    char scratch[32];
+    for (const auto &segment : segments) {
+        out += segment.literal;
+        if (segment.arg < 0) continue;
+        if ((size_t)segment.arg >= values.size()) {
+            out += "{?}";
+            ok = false;
+            continue;
+        }
+        const auto &value = values[segment.arg];
+        switch (value.kind) {
+            case field_kind_t::INT:
+                if (segment.spec.empty()) out.append(scratch, std::to_chars(scratch, scratch + sizeof(scratch), value.i).ptr);
+                else ok &= formatSpec(out, segment.spec, value.i);
+                break;
+            case field_kind_t::UINT:
+                if (segment.spec.empty()) out.append(scratch, std::to_chars(scratch, scratch + sizeof(scratch), value.u).ptr);
+                else ok &= formatSpec(out, segment.spec, value.u);
+                break;
+            case field_kind_t::DOUBLE:
+                // Shortest round trip, the same as std::format("{}").
+                if (segment.spec.empty()) out.append(scratch, std::to_chars(scratch, scratch + sizeof(scratch), value.d).ptr);
+                else ok &= formatSpec(out, segment.spec, value.d);
+                break;
+            case field_kind_t::BOOL:
+                if (segment.spec.empty()) out += value.b ? "true" : "false";
+                else ok &= formatSpec(out, segment.spec, value.b);
+                break;
+            case field_kind_t::STRING:
+                if (segment.spec.empty()) out += value.text;
+                else ok &= formatSpec(out, segment.spec, value.text);
+                break;
+            default:
+                field_json(out, value);
+        }
+    }
+    return ok;
+}
+
+char *vs_logger::encode_ref(char *dst, const template_ref_t &ref) {
+    return put_varint(put_varint(put_varint(dst, ref.id), ref.format_length), ref.definition);
+}
+
+bool vs_logger::decode_ref(std::string_view &bytes, template_ref_t &ref) {
+    const char *p = bytes.data(), *end = p + bytes.size();
+    if (!get_varint(p, end, ref.id) || !get_varint(p, end, ref.format_length) || !get_varint(p, end, ref.definition))
+        return false;
+    bytes.remove_prefix(p - bytes.data());
+    return true;
+}
+
+namespace {
+
+struct format_key_t {
+    const char *data;
+    size_t size;
+
+    bool operator==(const format_key_t &) const = default;
+};
+
+struct format_key_hash {
+    size_t operator()(const format_key_t &key) const {
+        return std::hash<const void*>()(key.data) ^ std::hash<size_t>()(key.size) * 0x9e3779b97f4a7c15u;
+    }
+};
+
+struct registry_t {
+    std::mutex mutex;
+    // By text, so that copies of a literal in several translation units share an id. 0 if it cannot be interned.
+    std::unordered_map<std::string, uint32_t> ids;
+    std::deque<vs_logger::format_template_t> templates;   // Id n at n - 1, never moved.
+};
+
+registry_t &registry() {
+    static registry_t instance;
+    return instance;
+}
+
+}
+
+uint32_t vs_logger::intern_format(std::string_view format) {
+    // The template is kept along with the id: the address of a literal from a library unloaded since may
+    // now hold another string of the same length, so a hit only counts if the text is still the same.
+    // Formats which cannot be interned are not checked, a stale 0 only leaves a format rendered eagerly.
+    static thread_local std::unordered_map<format_key_t, std::pair<uint32_t, const format_template_t*>, format_key_hash> cache;
+    format_key_t key{format.data(), format.size()};
+    auto cached = cache.find(key);
+    if (cached != cache.end() && (!cached->second.second || cached->second.second->format() == format))
+        return cached->second.first;
+
+    auto &dictionary = registry();
+    uint32_t id;
+    const format_template_t *parsed = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(dictionary.mutex);
+        auto [it, inserted] = dictionary.ids.try_emplace(std::string(format), 0);
+        if (inserted) {
+            if (auto result = format_template_t::parse(format)) {
+                dictionary.templates.push_back(std::move(*result));
+                it->second = (uint32_t)dictionary.templates.size();
+            }
+        }
+        id = it->second;
+        if (id) parsed = &dictionary.templates[id - 1];
+    }
+    if (cached != cache.end()) cached->second = {id, parsed};
+    else cache.emplace(key, std::make_pair(id, parsed));
+    return id;
+}
+
+const vs_logger::format_template_t *vs_logger::interned_format(uint32_t id) {
+    auto &dictionary = registry();
+    std::lock_guard<std::mutex> lock(dictionary.mutex);
+    return id > 0 && id <= dictionary.templates.size() ? &dictionary.templates[id - 1] : nullptr;
+}
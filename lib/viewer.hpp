@@ -0,0 +1,676 @@
+#pragma once
+
+// Single page log viewer served on "/", it receives the entries from the "/ws" endpoint.
+static constexpr const char *viewer_html = R"raw(
+<!DOCTYPE html>
+<html>
+<head>
+  <meta charset="utf-8">
+  <title>Advanced Live Log Viewer</title>
+  <style>
+    html, body {
+      height: 100%;
+      margin: 0;
+    }
+    /* Base layout & colors */
+    body {
+      font-family: Arial, sans-serif;
+      background-color: var(--bg-color);
+      color: var(--text-color);
+      display: flex;
+      flex-direction: column;
+    }
+    header {
+      background-color: var(--header-bg);
+      border-bottom: 1px solid var(--border-color);
+      display: flex;
+      align-items: center;
+      padding: 5px 10px;
+    }
+    header .connStatus {
+      font-size: 1.5em;
+      margin-right: 10px;
+    }
+    header h1 {
+      flex: 1;
+      margin: 0;
+      font-size: 1.5em;
+    }
+    header button {
+      margin-left: 10px;
+    }
+    .controls {
+      background-color: var(--header-bg);
+      border-bottom: 1px solid var(--border-color);
+      padding: 10px;
+    }
+    .controls label {
+      margin-right: 5px;
+    }
+    .controls input,
+    .controls select {
+      margin-right: 15px;
+      vertical-align: middle;
+    }
+    .controls button, .controls label.auto-scroll {
+      margin-right: 15px;
+      vertical-align: middle;
+    }
+    /* Light/dark theme variables */
+    :root {
+      --bg-color: #ffffff;
+      --text-color: #000000;
+      --header-bg: #f0f0f0;
+      --border-color: #ccc;
+      --table-header-bg: #e9e9e9;
+      --table-row-bg: #f8f8f8;
+    }
+    [data-theme="dark"] {
+      --bg-color: #1e1e1e;
+      --text-color: #e0e0e0;
+      --header-bg: #333;
+      --border-color: #555;
+      --table-header-bg: #444;
+      --table-row-bg: #262626;
+    }
+    /* Log panel styling: fill remaining screen space */
+    #logPanel {
+      flex: 1;
+      overflow-y: auto;
+      border-top: 1px solid var(--border-color);
+    }
+    table {
+      border-collapse: collapse;
+      width: 100%;
+    }
+    thead {
+      background-color: var(--table-header-bg);
+      position: sticky;
+      top: 0;
+      z-index: 1;
+    }
+    th, td {
+      padding: 8px;
+      border: 1px solid var(--border-color);
+      text-align: left;
+      font-family: monospace;
+      white-space: nowrap;
+      overflow: hidden;
+      text-overflow: ellipsis;
+    }
+    /* Set fixed widths for all columns except message */
+    th.timestamp, td.timestamp { width: 130px; }
+    th.type, td.type { width: 60px; text-align: center; }
+    th.severity, td.severity { width: 80px; }
+    th.parent, td.parent { width: 200px; cursor: pointer; }
+    th.activity, td.activity { width: 200px; cursor: pointer; }
+    th.seq, td.seq { width: 60px; }
+    th.message, td.message { width: auto; }
+    td.message .fields { color: #666; }
+    /* Only the visible rows are in the table, spacers stand for the others */
+    tr.spacer td { padding: 0; border: none; }
+  </style>
+</head>
+<body data-theme="light">
+  <header>
+    <!-- Connection Status Icon: chain when connected, broken chain when disconnected -->
+    <div class="connStatus" id="connStatus" title="Connection Status">⛓️</div>
+    <h1>Advanced Live Log Viewer</h1>
+    <button id="toggleTheme">Toggle Dark/Light</button>
+    <button id="muteAudioBtn">Mute Panic Audio</button>
+  </header>
+  <div class="controls">
+    <!-- Filter & Export Controls -->
+    <label title="Type: OK = Successful, INFO = Information, WARNING = Warning, ERROR = Error, PANIC = Panic">Type</label>
+    <select id="filterType">
+      <option value="">(All)</option>
+      <option value="OK">✔️ OK – Successful</option>
+      <option value="INFO">ℹ️ INFO – Information</option>
+      <option value="WARNING">⚠️ WARNING – Warning</option>
+      <option value="ERROR">❌ ERROR – Error</option>
+      <option value="PANIC">⛔ PANIC – Panic</option>
+    </select>
+
+    <label title="Severity: NONE, LOW, MID, HIGH">Severity</label>
+    <select id="filterSeverity">
+      <option value="">(All)</option>
+      <option value="NONE">NONE</option>
+      <option value="LOW">LOW</option>
+      <option value="MID">MID</option>
+      <option value="HIGH">HIGH</option>
+    </select>
+
+    <label title="Activity UUID">Activity 🆔</label>
+    <input type="text" id="filterActivity" placeholder="Activity UUID">
+
+    <label title="Parent UUID">Parent 🔗</label>
+    <input type="text" id="filterParent" placeholder="Parent UUID">
+
+    <label title="Keyword Search">Search 🔍</label>
+    <input type="text" id="searchText" placeholder="Search text...">
+    
+    <label title="Oldest entries are dropped past this count">Max entries</label>
+    <input type="number" id="maxEntries" min="1000" step="1000" value="100000" style="width: 7em">
+
+    <button id="exportBtn">Export CSV</button>
+    <button id="clearLogsBtn">Clear Logs</button>
+    
+    <label class="auto-scroll" title="Toggle auto-scroll on/off">
+      <input type="checkbox" id="autoScroll" checked> Auto-scroll
+    </label>
+  </div>
+  <div id="logPanel">
+    <table id="logTable">
+      <thead>
+        <tr>
+          <th class="timestamp">Timestamp</th>
+          <th class="type">Type</th>
+          <th class="severity">Severity</th>
+          <th class="parent">Parent UUID</th>
+          <th class="activity">Activity UUID</th>
+          <th class="seq">Seq ID</th>
+          <th class="message">Message</th>
+        </tr>
+      </thead>
+      <tbody>
+      </tbody>
+    </table>
+  </div>
+
+  <!-- Audio element for PANIC logs -->
+  <audio id="panicSound" preload="auto">
+    <source src="data:audio/wav;base64,UklGRhwMAABXQVZFZm10IBAAAAABAAEAgD4AAIA+AAABAAgAZGF0Ya4LAACAgICAgICAgICAgICAgICAgICAgICAgICAf3hxeH+AfXZ1eHx6dnR5fYGFgoOKi42aloubq6GOjI2Op7ythXJ0eYF5aV1AOFFib32HmZSHhpCalIiYi4SRkZaLfnhxaWptb21qaWBea2BRYmZTVmFgWFNXVVVhaGdbYGhZbXh1gXZ1goeIlot1k6yxtKaOkaWhq7KonKCZoaCjoKWuqqmurK6ztrO7tbTAvru/vb68vbW6vLGqsLOfm5yal5KKhoyBeHt2dXBnbmljVlJWUEBBPDw9Mi4zKRwhIBYaGRQcHBURGB0XFxwhGxocJSstMjg6PTc6PUxVV1lWV2JqaXN0coCHhIyPjpOenqWppK6xu72yxMu9us7Pw83Wy9nY29ve6OPr6uvs6ezu6ejk6erm3uPj3dbT1sjBzdDFuMHAt7m1r7W6qaCupJOTkpWPgHqAd3JrbGlnY1peX1hTUk9PTFRKR0RFQkRBRUVEQkdBPjs9Pzo6NT04Njs+PTxAPzo/Ojk6PEA5PUJAQD04PkRCREZLUk1KT1BRUVdXU1VRV1tZV1xgXltcXF9hXl9eY2VmZmlna3J0b3F3eHyBfX+JgIWJiouTlZCTmpybnqSgnqyrqrO3srK2uL2/u7jAwMLFxsfEv8XLzcrIy83JzcrP0s3M0dTP0drY1dPR1dzc19za19XX2dnU1NjU0dXPzdHQy8rMysfGxMLBvLu3ta+sraeioJ2YlI+MioeFfX55cnJsaWVjXVlbVE5RTktHRUVAPDw3NC8uLyknKSIiJiUdHiEeGx4eHRwZHB8cHiAfHh8eHSEhISMoJyMnKisrLCszNy8yOTg9QEJFRUVITVFOTlJVWltaXmNfX2ZqZ21xb3R3eHqAhoeJkZKTlZmhpJ6kqKeur6yxtLW1trW4t6+us7axrbK2tLa6ury7u7u9u7vCwb+/vr7Ev7y9v8G8vby6vru4uLq+tri8ubi5t7W4uLW5uLKxs7G0tLGwt7Wvs7avr7O0tLW4trS4uLO1trW1trm1tLm0r7Kyr66wramsqaKlp52bmpeWl5KQkImEhIB8fXh3eHJrbW5mYGNcWFhUUE1LRENDQUI9ODcxLy8vMCsqLCgoKCgpKScoKCYoKygpKyssLi0sLi0uMDIwMTIuLzQ0Njg4Njc8ODlBQ0A/RUdGSU5RUVFUV1pdXWFjZGdpbG1vcXJ2eXh6fICAgIWIio2OkJGSlJWanJqbnZ2cn6Kkp6enq62srbCysrO1uLy4uL+/vL7CwMHAvb/Cvbq9vLm5uba2t7Sysq+urqyqqaalpqShoJ+enZuamZqXlZWTkpGSkpCNjpCMioqLioiHhoeGhYSGg4GDhoKDg4GBg4GBgoGBgoOChISChISChIWDg4WEgoSEgYODgYGCgYGAgICAgX99f398fX18e3p6e3t7enp7fHx4e3x6e3x7fHx9fX59fn1+fX19fH19fnx9fn19fX18fHx7fHx6fH18fXx8fHx7fH1+fXx+f319fn19fn1+gH9+f4B/fn+AgICAgH+AgICAgIGAgICAgH9+f4B+f35+fn58e3t8e3p5eXh4d3Z1dHRzcXBvb21sbmxqaWhlZmVjYmFfX2BfXV1cXFxaWVlaWVlYV1hYV1hYWVhZWFlaWllbXFpbXV5fX15fYWJhYmNiYWJhYWJjZGVmZ2hqbG1ub3Fxc3V3dnd6e3t8e3x+f3+AgICAgoGBgoKDhISFh4aHiYqKi4uMjYyOj4+QkZKUlZWXmJmbm52enqCioqSlpqeoqaqrrK2ur7CxsrGys7O0tbW2tba3t7i3uLe4t7a3t7i3tre2tba1tLSzsrKysbCvrq2sq6qop6alo6OioJ+dnJqZmJeWlJKSkI+OjoyLioiIh4WEg4GBgH9+fXt6eXh3d3V0c3JxcG9ubWxsamppaWhnZmVlZGRjYmNiYWBhYGBfYF9fXl5fXl1dXVxdXF1dXF1cXF1cXF1dXV5dXV5fXl9eX19gYGFgYWJhYmFiY2NiY2RjZGNkZWRlZGVmZmVmZmVmZ2dmZ2hnaGhnaGloZ2hpaWhpamlqaWpqa2pra2xtbGxtbm1ubm5vcG9wcXBxcnFycnN0c3N0dXV2d3d4eHh5ent6e3x9fn5/f4CAgIGCg4SEhYaGh4iIiYqLi4uMjY2Oj5CQkZGSk5OUlJWWlpeYl5iZmZqbm5ybnJ2cnZ6en56fn6ChoKChoqGio6KjpKOko6SjpKWkpaSkpKSlpKWkpaSlpKSlpKOkpKOko6KioaKhoaCfoJ+enp2dnJybmpmZmJeXlpWUk5STkZGQj4+OjYyLioqJh4eGhYSEgoKBgIB/fn59fHt7enl5eHd3dnZ1dHRzc3JycXBxcG9vbm5tbWxrbGxraWppaWhpaGdnZ2dmZ2ZlZmVmZWRlZGVkY2RjZGNkZGRkZGRkZGRkZGRjZGRkY2RjZGNkZWRlZGVmZWZmZ2ZnZ2doaWhpaWpra2xsbW5tbm9ub29wcXFycnNzdHV1dXZ2d3d4eXl6enp7fHx9fX5+f4CAgIGAgYGCgoOEhISFhoWGhoeIh4iJiImKiYqLiouLjI2MjI2OjY6Pj46PkI+QkZCRkJGQkZGSkZKRkpGSkZGRkZKRkpKRkpGSkZKRkpGSkZKRkpGSkZCRkZCRkI+Qj5CPkI+Pjo+OjY6Njo2MjYyLjIuMi4qLioqJiomJiImIh4iHh4aHhoaFhoWFhIWEg4SDg4KDgoKBgoGAgYCBgICAgICAf4CAf39+f35/fn1+fX59fHx9fH18e3x7fHt6e3p7ent6e3p5enl6enl6eXp5eXl4eXh5eHl4eXh5eHl4eXh5eHh3eHh4d3h4d3h3d3h4d3l4eHd4d3h3eHd4d3h3eHh4eXh5eHl4eHl4eXh5enl6eXp5enl6eXp5ent6ent6e3x7fHx9fH18fX19fn1+fX5/fn9+f4B/gH+Af4CAgICAgIGAgYCBgoGCgYKCgoKDgoOEg4OEg4SFhIWEhYSFhoWGhYaHhoeHhoeGh4iHiIiHiImIiImKiYqJiYqJiouKi4qLiouKi4qLiouKi4qLiouKi4qLi4qLiouKi4qLiomJiomIiYiJiImIh4iIh4iHhoeGhYWGhYaFhIWEg4OEg4KDgoOCgYKBgIGAgICAgH+Af39+f359fn18fX19fHx8e3t6e3p7enl6eXp5enl6enl5eXh5eHh5eHl4eXh5eHl4eHd5eHd3eHl4d3h3eHd4d3h3eHh4d3h4d3h3d3h5eHl4eXh5eHl5eXp5enl6eXp7ent6e3p7e3t7fHt8e3x8fHx9fH1+fX59fn9+f35/gH+AgICAgICAgYGAgYKBgoGCgoKDgoOEg4SEhIWFhIWFhoWGhYaGhoaHhoeGh4aHhoeIh4iHiIeHiIeIh4iHiIeIiIiHiIeIh4iHiIiHiIeIh4iHiIeIh4eIh4eIh4aHh4aHhoeGh4aHhoWGhYaFhoWFhIWEhYSFhIWEhISDhIOEg4OCg4OCg4KDgYKCgYKCgYCBgIGAgYCBgICAgICAgICAf4B/f4B/gH+Af35/fn9+f35/fn1+fn19fn1+fX59fn19fX19fH18fXx9fH18fXx9fH18fXx8fHt8e3x7fHt8e3x7fHt8e3x7fHt8e3x7fHt8e3x7fHt8e3x8e3x7fHt8e3x7fHx8fXx9fH18fX5+fX59fn9+f35+f35/gH+Af4B/gICAgICAgICAgICAgYCBgIGAgIGAgYGBgoGCgYKBgoGCgYKBgoGCgoKDgoOCg4KDgoOCg4KDgoOCg4KDgoOCg4KDgoOCg4KDgoOCg4KDgoOCg4KDgoOCg4KDgoOCg4KDgoOCg4KCgoGCgYKBgoGCgYKBgoGCgYKBgoGCgYKBgoGCgYKBgoGCgYKBgoGCgYKBgoGBgYCBgIGAgYCBgIGAgYCBgIGAgYCBgIGAgYCBgIGAgYCAgICBgIGAgYCBgIGAgYCBgIGAgYCBgExJU1RCAAAASU5GT0lDUkQMAAAAMjAwOC0wOS0yMQAASUVORwMAAAAgAAABSVNGVBYAAABTb255IFNvdW5kIEZvcmdlIDguMAAA" />
+    Your browser does not support the audio element.
+  </audio>
+
+  <script>
+    // Utility function to save settings to localStorage
+    function saveSettings() {
+      const settings = {
+        filterType: document.getElementById("filterType").value,
+        filterSeverity: document.getElementById("filterSeverity").value,
+        filterActivity: document.getElementById("filterActivity").value,
+        filterParent: document.getElementById("filterParent").value,
+        searchText: document.getElementById("searchText").value,
+        autoScroll: document.getElementById("autoScroll").checked,
+        maxEntries: document.getElementById("maxEntries").value,
+        theme: document.body.getAttribute("data-theme"),
+        panicAudioMuted: document.getElementById("panicSound").muted
+      };
+      localStorage.setItem("logViewerSettings", JSON.stringify(settings));
+    }
+
+    // Utility function to load settings from localStorage
+    function loadSettings() {
+      const settingsStr = localStorage.getItem("logViewerSettings");
+      if (settingsStr) {
+        const settings = JSON.parse(settingsStr);
+        document.getElementById("filterType").value = settings.filterType || "";
+        document.getElementById("filterSeverity").value = settings.filterSeverity || "";
+        document.getElementById("filterActivity").value = settings.filterActivity || "";
+        document.getElementById("filterParent").value = settings.filterParent || "";
+        document.getElementById("searchText").value = settings.searchText || "";
+        document.getElementById("autoScroll").checked = (settings.autoScroll === undefined) ? true : settings.autoScroll;
+        document.getElementById("maxEntries").value = settings.maxEntries || 100000;
+        document.body.setAttribute("data-theme", settings.theme || "light");
+        document.getElementById("panicSound").muted = settings.panicAudioMuted || false;
+        updateMuteButton();
+      }
+    }
+
+    // Update mute button's label
+    function updateMuteButton() {
+      const muteBtn = document.getElementById("muteAudioBtn");
+      const panicAudioMuted = document.getElementById("panicSound").muted;
+      muteBtn.textContent = panicAudioMuted ? "Unmute Panic Audio" : "Mute Panic Audio";
+    }
+
+    // Data store for logs, ordered by seq_id, and the seq_ids it holds.
+    let logStore = [];
+    let seenSeqs = new Set();
+    // The entries of logStore passing the current filters, which is what the table shows.
+    let filteredLogs = [];
+    // Entries and frame acknowledgements collected until the next animation frame.
+    let pendingEntries = [];
+    let pendingAcks = 0;
+    let flushScheduled = false;
+
+    // Colors for type icons only (the cell showing the unicode icon)
+    const typeColors = {
+      "OK": "#008000",       // green
+      "INFO": "#0000FF",     // blue
+      "WARNING": "#FFA500",  // orange
+      "ERROR": "#FF0000",    // red
+      "PANIC": "#800080"     // purple
+    };
+
+    // Unicode mapping for type filtering icons and tooltips.
+    const typeIcons = {
+      "OK": { icon: "✔️", title: "OK – Successful message" },
+      "INFO": { icon: "ℹ️", title: "INFO – Information message" },
+      "WARNING": { icon: "⚠️", title: "WARNING – Warning message" },
+      "ERROR": { icon: "❌", title: "ERROR – Error message" },
+      "PANIC": { icon: "⛔", title: "PANIC – Panic message" }
+    };
+
+    // WebSocket setup & auto-reconnect
+    const wsUrl = "ws://" + location.host + "/ws";
+    let ws;
+    let reconnectInterval = 5000; // milliseconds
+    let missedEntries = 0;
+
+    function setConnectionStatus(connected) {
+      const connStatusEl = document.getElementById("connStatus");
+      if (connected) {
+        connStatusEl.textContent = "⛓️"; // chain icon
+        connStatusEl.title = "Connected";
+      } else {
+        connStatusEl.textContent = "🔌"; // unplug icon
+        connStatusEl.title = "Disconnected";
+      }
+    }
+
+    // Let the server drop the entries the type and severity filters would hide anyway.
+    // Severity is only a lower bound there, the exact match is still done here.
+    function subscribe() {
+      if (!ws || ws.readyState !== WebSocket.OPEN) return;
+      const type = document.getElementById("filterType").value;
+      const severity = document.getElementById("filterSeverity").value;
+      const filter = {};
+      if (type) filter.types = [type];
+      if (severity) filter.min_severity = severity;
+      ws.send("filter " + JSON.stringify(filter));
+    }
+
+    // After a subscription change, get back the retained entries the previous one excluded.
+    function resubscribe() {
+      subscribe();
+      if (ws && ws.readyState === WebSocket.OPEN) ws.send("since 0");
+    }
+
+    // Every frame holds one or more newline-terminated entries.
+    function handleFrame(text) {
+      for (const line of text.split("\n")) {
+        if (!line) continue;
+        try {
+          const data = JSON.parse(line);
+          if (data.missed !== undefined) {
+            missedEntries += data.missed;
+            document.getElementById("connStatus").title = "Connected, " + missedEntries + " entries missed";
+            continue;
+          }
+          pendingEntries.push(data);
+        } catch (e) {
+          console.error("Error parsing message", e);
+        }
+      }
+      scheduleFlush();
+    }
+
+    function scheduleFlush() {
+      if (flushScheduled) return;
+      flushScheduled = true;
+      requestAnimationFrame(flushPending);
+    }
+
+    // Merge everything received since the last animation frame, then acknowledge the frames it came
+    // in. A hidden page gets no animation frames, so the server holds back instead of flooding it.
+    function flushPending() {
+      flushScheduled = false;
+      const filters = currentFilters();
+      let panic = false;
+      for (const log of pendingEntries) {
+        if (seenSeqs.has(log.seq_id)) continue;
+        seenSeqs.add(log.seq_id);
+        insertOrdered(logStore, log);
+        if (matchesFilters(log, filters)) insertOrdered(filteredLogs, log);
+        panic = panic || log.type === "PANIC";
+      }
+      pendingEntries = [];
+      trimLogs();
+      renderRows();
+      // Play sound for PANIC logs (if not muted).
+      if (panic) {
+        const panicSound = document.getElementById("panicSound");
+        panicSound.play().catch(e => console.error(e));
+      }
+      if (ws && ws.readyState === WebSocket.OPEN)
+        for (; pendingAcks > 0; pendingAcks--) ws.send("ack");
+      pendingAcks = 0;
+    }
+
+    // Entries mostly arrive in order, so this is usually a push.
+    function insertOrdered(logs, log) {
+      if (!logs.length || logs[logs.length - 1].seq_id < log.seq_id) {
+        logs.push(log);
+        return;
+      }
+      let lo = 0, hi = logs.length;
+      while (lo < hi) {
+        const mid = (lo + hi) >> 1;
+        if (logs[mid].seq_id < log.seq_id) lo = mid + 1; else hi = mid;
+      }
+      logs.splice(lo, 0, log);
+    }
+
+    // Drop the oldest entries past the configured maximum.
+    function trimLogs() {
+      const maxEntries = Math.max(parseInt(document.getElementById("maxEntries").value) || 100000, 1000);
+      const excess = logStore.length - maxEntries;
+      if (excess <= 0) return;
+      for (const log of logStore.splice(0, excess)) seenSeqs.delete(log.seq_id);
+      const first = logStore[0].seq_id;
+      let dropped = 0;
+      while (dropped < filteredLogs.length && filteredLogs[dropped].seq_id < first) dropped++;
+      if (dropped) filteredLogs.splice(0, dropped);
+    }
+
+    // Binary frames are the pieces of one raw deflate stream lasting as long as the connection.
+    // Every frame ends on a flush, so the text inflated so far always ends with a complete entry.
+    function createInflater() {
+      const stream = new DecompressionStream("deflate-raw");
+      const reader = stream.readable.pipeThrough(new TextDecoderStream()).getReader();
+      let pending = "";
+      (async () => {
+        for (;;) {
+          const { value, done } = await reader.read();
+          if (done) return;
+          pending += value;
+          const end = pending.lastIndexOf("\n");
+          if (end < 0) continue;
+          handleFrame(pending.slice(0, end + 1));
+          pending = pending.slice(end + 1);
+        }
+      })().catch(e => console.error("Error inflating frames", e));
+      return stream.writable.getWriter();
+    }
+
+    function connectWebSocket() {
+      const socket = new WebSocket(wsUrl);
+      let inflater = null;
+      ws = socket;
+      socket.binaryType = "arraybuffer";
+      socket.onopen = () => {
+        setConnectionStatus(true);
+        pendingAcks = 0;
+        // Entries are highly repetitive, ask for a compressed stream when the browser can inflate it.
+        if ("DecompressionStream" in window) {
+          inflater = createInflater();
+          socket.send("deflate");
+        }
+        subscribe();
+        // Ask the server for whatever was logged while we were away.
+        const lastSeq = logStore.length ? logStore[logStore.length - 1].seq_id : 0;
+        socket.send("since " + lastSeq);
+      };
+      // Frames are acknowledged once rendered so the server never has more than a few in flight
+      // towards this page.
+      socket.onmessage = (event) => {
+        if (typeof event.data === "string") {
+          pendingAcks++;
+          handleFrame(event.data);
+        } else if (inflater) {
+          inflater.write(new Uint8Array(event.data))
+            .then(() => {
+              if (ws !== socket) return;
+              pendingAcks++;
+              scheduleFlush();
+            })
+            .catch(e => console.error("Error inflating frame", e));
+        }
+      };
+      socket.onclose = () => {
+        if (inflater) inflater.close().catch(() => {});
+        setConnectionStatus(false);
+        setTimeout(connectWebSocket, reconnectInterval);
+      };
+      socket.onerror = (err) => {
+        console.error("WebSocket error", err);
+        socket.close();
+      };
+    }
+    connectWebSocket();
+
+    // Filters of the controls, read once for a whole pass.
+    function currentFilters() {
+      return {
+        type: document.getElementById("filterType").value,
+        severity: document.getElementById("filterSeverity").value,
+        activity: document.getElementById("filterActivity").value.trim().toLowerCase(),
+        parent: document.getElementById("filterParent").value.trim().toLowerCase(),
+        text: document.getElementById("searchText").value.toLowerCase()
+      };
+    }
+
+    // Filter logic: allow filtering by type, severity, activity_uuid, parent_uuid, and message content.
+    function matchesFilters(log, f) {
+      const matchType = f.type ? log.type === f.type : true;
+      const matchSeverity = f.severity ? log.severity === f.severity : true;
+      const matchActivity = f.activity ? (log.activity_uuid && log.activity_uuid.toLowerCase().includes(f.activity)) : true;
+      const matchParent = f.parent ? (log.parent_uuid && log.parent_uuid.toLowerCase().includes(f.parent)) : true;
+      const matchText = f.text ? ((log.message && log.message.toLowerCase().includes(f.text)) ||
+                                  formatFields(log).toLowerCase().includes(f.text) ||
+                                  (log.activity_uuid && log.activity_uuid.toLowerCase().includes(f.text)) ||
+                                  (log.parent_uuid && log.parent_uuid.toLowerCase().includes(f.text))) : true;
+      return matchType && matchSeverity && matchActivity && matchParent && matchText;
+    }
+
+    // Typed fields of an entry as "key=value" pairs, empty if it has none.
+    function formatFields(log) {
+      if (!log.fields) return "";
+      return Object.entries(log.fields).map(([key, value]) => key + "=" + JSON.stringify(value)).join(" ");
+    }
+
+    // Rebuild the filtered view after a filter change, then render it.
+    function renderLogs() {
+      const filters = currentFilters();
+      filteredLogs = logStore.filter(log => matchesFilters(log, filters));
+      renderRows();
+    }
+
+    // Rows all have the same height (cells never wrap), measured on the first one rendered.
+    let rowHeight = 0;
+    const overscan = 20;
+
+    // Timestamps are wall-clock microseconds since the epoch, shown as local time of day.
+    function formatTimestamp(us) {
+      const date = new Date(Math.floor(us / 1000));
+      const pad = (n, width) => String(n).padStart(width, "0");
+      return pad(date.getHours(), 2) + ":" + pad(date.getMinutes(), 2) + ":" +
+        pad(date.getSeconds(), 2) + "." + pad(us % 1000000, 6);
+    }
+
+    function createRow(log, index) {
+      const tr = document.createElement("tr");
+      tr.dataset.index = index;
+
+      // Timestamp cell.
+      const tdTimestamp = document.createElement("td");
+      tdTimestamp.className = "timestamp";
+      tdTimestamp.textContent = formatTimestamp(log.timestamp);
+      tdTimestamp.title = new Date(Math.floor(log.timestamp / 1000)).toISOString();
+      tr.appendChild(tdTimestamp);
+
+      // Type cell with icon, color, and tooltip.
+      const tdType = document.createElement("td");
+      tdType.className = "type";
+      if (typeIcons[log.type]) {
+        tdType.textContent = typeIcons[log.type].icon;
+        tdType.title = typeIcons[log.type].title;
+        tdType.style.color = typeColors[log.type];
+      } else {
+        tdType.textContent = log.type;
+      }
+      tr.appendChild(tdType);
+
+      // Severity cell.
+      const tdSeverity = document.createElement("td");
+      tdSeverity.className = "severity";
+      tdSeverity.textContent = log.severity;
+      tr.appendChild(tdSeverity);
+
+      // Parent UUID cell (clickable)
+      const tdParent = document.createElement("td");
+      tdParent.className = "parent";
+      tdParent.textContent = log.parent_uuid;
+      tdParent.title = "Click to filter by Parent UUID";
+      tr.appendChild(tdParent);
+
+      // Activity UUID cell (clickable)
+      const tdActivity = document.createElement("td");
+      tdActivity.className = "activity";
+      tdActivity.textContent = log.activity_uuid;
+      tdActivity.title = "Click to filter by Activity UUID";
+      tr.appendChild(tdActivity);
+
+      // Sequence ID cell.
+      const tdSeq = document.createElement("td");
+      tdSeq.className = "seq";
+      tdSeq.textContent = log.seq_id;
+      tr.appendChild(tdSeq);
+
+      // Message cell.
+      const tdMessage = document.createElement("td");
+      tdMessage.className = "message";
+      tdMessage.textContent = log.message;
+      const fields = formatFields(log);
+      if (fields) {
+        const spanFields = document.createElement("span");
+        spanFields.className = "fields";
+        spanFields.textContent = " " + fields;
+        tdMessage.appendChild(spanFields);
+      }
+      tr.appendChild(tdMessage);
+      return tr;
+    }
+
+    function createSpacer(height) {
+      const tr = document.createElement("tr");
+      tr.className = "spacer";
+      const td = document.createElement("td");
+      td.colSpan = 7;
+      td.style.height = height + "px";
+      tr.appendChild(td);
+      return tr;
+    }
+
+    // Render the rows in view (plus some margin) of the filtered logs, spacers stand for the rest.
+    // Unless the user is scrolling, auto-scroll keeps the view on the newest entries.
+    function renderRows(scrolling = false) {
+      const panel = document.getElementById("logPanel");
+      const tbody = document.getElementById("logTable").querySelector("tbody");
+      const height = rowHeight || 34;
+      const autoScroll = !scrolling && document.getElementById("autoScroll").checked;
+      const visible = Math.ceil(panel.clientHeight / height) + 2 * overscan;
+      let first = autoScroll ? filteredLogs.length - visible : Math.floor(panel.scrollTop / height) - overscan;
+      first = Math.max(0, Math.min(first, filteredLogs.length - visible));
+      const last = Math.min(filteredLogs.length, first + visible);
+
+      const rows = document.createDocumentFragment();
+      rows.appendChild(createSpacer(first * height));
+      for (let i = first; i < last; i++) rows.appendChild(createRow(filteredLogs[i], i));
+      rows.appendChild(createSpacer((filteredLogs.length - last) * height));
+      tbody.replaceChildren(rows);
+
+      if (!rowHeight && last > first) {
+        rowHeight = tbody.rows[1].getBoundingClientRect().height || height;
+        if (rowHeight !== height) return renderRows(scrolling);
+      }
+      // Auto-scroll if enabled.
+      if (autoScroll) panel.scrollTop = panel.scrollHeight;
+    }
+
+    // Scrolling only changes which rows are in the table.
+    let scrollScheduled = false;
+    document.getElementById("logPanel").addEventListener("scroll", () => {
+      if (scrollScheduled) return;
+      scrollScheduled = true;
+      requestAnimationFrame(() => { scrollScheduled = false; renderRows(true); });
+    });
+    window.addEventListener("resize", () => renderRows());
+
+    // Clicking a UUID filters by it.
+    document.getElementById("logTable").querySelector("tbody").addEventListener("click", (event) => {
+      const td = event.target.closest("td");
+      const tr = td && td.parentElement;
+      if (!tr || tr.dataset.index === undefined) return;
+      const log = filteredLogs[tr.dataset.index];
+      if (!log) return;
+      if (td.classList.contains("parent")) document.getElementById("filterParent").value = log.parent_uuid;
+      else if (td.classList.contains("activity")) document.getElementById("filterActivity").value = log.activity_uuid;
+      else return;
+      renderLogs();
+      saveSettings();
+    });
+
+    // Attach filtering events and save changes.
+    document.getElementById("filterType").addEventListener("change", () => { resubscribe(); renderLogs(); saveSettings(); });
+    document.getElementById("filterSeverity").addEventListener("change", () => { resubscribe(); renderLogs(); saveSettings(); });
+    document.getElementById("filterActivity").addEventListener("input", () => { renderLogs(); saveSettings(); });
+    document.getElementById("filterParent").addEventListener("input", () => { renderLogs(); saveSettings(); });
+    document.getElementById("searchText").addEventListener("input", () => { renderLogs(); saveSettings(); });
+    document.getElementById("autoScroll").addEventListener("change", () => { renderRows(); saveSettings(); });
+    document.getElementById("maxEntries").addEventListener("change", () => { trimLogs(); renderRows(); saveSettings(); });
+
+    // CSV export functionality.
+    function escapeCSV(value) {
+      if (typeof value === 'string' && (value.includes(',') || value.includes('"') || value.includes('\n'))) {
+        return '"' + value.replace(/"/g, '""') + '"';
+      }
+      return value;
+    }
+    document.getElementById("exportBtn").addEventListener("click", () => {
+      let csvContent = "timestamp,type,severity,parent_uuid,activity_uuid,seq_id,message,fields\n";
+      filteredLogs.forEach(log => {
+        csvContent += [
+          escapeCSV(log.timestamp),
+          escapeCSV(log.type),
+          escapeCSV(log.severity),
+          escapeCSV(log.parent_uuid),
+          escapeCSV(log.activity_uuid),
+          log.seq_id,
+          escapeCSV(log.message),
+          escapeCSV(formatFields(log))
+        ].join(",") + "\n";
+      });
+      
+      const blob = new Blob([csvContent], { type: "text/csv;charset=utf-8;" });
+      const url = URL.createObjectURL(blob);
+      const a = document.createElement("a");
+      a.href = url;
+      a.download = "logs.csv";
+      document.body.appendChild(a);
+      a.click();
+      document.body.removeChild(a);
+    });
+
+    // Clear logs functionality.
+    document.getElementById("clearLogsBtn").addEventListener("click", () => {
+      logStore = [];
+      seenSeqs = new Set();
+      filteredLogs = [];
+      renderRows();
+    });
+
+    // Toggle theme.
+    document.getElementById("toggleTheme").addEventListener("click", () => {
+      const bodyEl = document.body;
+      bodyEl.setAttribute("data-theme", bodyEl.getAttribute("data-theme") === "light" ? "dark" : "light");
+      saveSettings();
+    });
+
+    // Mute/unmute panic audio.
+    document.getElementById("muteAudioBtn").addEventListener("click", () => {
+      const panicAudio = document.getElementById("panicSound");
+      panicAudio.muted = !panicAudio.muted;
+      updateMuteButton();
+      saveSettings();
+    });
+
+    // Load settings on page load.
+    loadSettings();
+    renderLogs();
+  </script>
+</body>
+</html>
+)raw";
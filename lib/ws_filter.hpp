@@ -0,0 +1,261 @@
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <regex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "vs-logger/fields.hpp"
+#include "vs-logger/json.hpp"
+#include "vs-logger/crow_all.h"
+
+// Parsing and matching of serialized entries for the WebSocket clients of run_server().
+
+namespace vs_logger {
+
+// Call f on every newline-terminated entry of a datagram, newline included.
+template<typename F>
+inline void for_each_line(std::string_view datagram, F&& f) {
+    while (!datagram.empty()) {
+        size_t end = datagram.find('\n');
+        auto line = datagram.substr(0, end == std::string_view::npos ? datagram.size() : end + 1);
+        datagram.remove_prefix(line.size());
+        f(line);
+    }
+}
+
+// The seq_id field of a serialized entry, zero if it has none.
+inline uint64_t entry_seq(std::string_view line) {
+    constexpr std::string_view key = "\"seq_id\":";
+    size_t pos = line.find(key);
+    uint64_t seq = 0;
+    if (pos != std::string_view::npos)
+        std::from_chars(line.data() + pos + key.size(), line.data() + line.size(), seq);
+    return seq;
+}
+
+// A serialized entry, as produced by Logger::formatJson().
+struct ws_entry_t {
+    std::string_view type, severity, message;
+    std::string_view fields;   // The "fields" object, braces included, empty if there is none.
+    uint64_t activity_uuid = 0, parent_uuid = 0;
+
+    explicit ws_entry_t(std::string_view line) {
+        type = field(line, "\"type\":\"");
+        severity = field(line, "\"severity\":\"");
+        auto activity = field(line, "\"activity_uuid\":\"");
+        std::from_chars(activity.data(), activity.data() + activity.size(), activity_uuid);
+        auto parent = field(line, "\"parent_uuid\":\"");
+        std::from_chars(parent.data(), parent.data() + parent.size(), parent_uuid);
+        // The message is the last field, still JSON-escaped. Searching from the end skips a field named
+        // "message": escaped strings never hold a bare quote.
+        size_t start = line.rfind("\"message\":\"");
+        size_t end = line.rfind("\"}");
+        if (start != std::string_view::npos && end != std::string_view::npos && end >= start + 11)
+            message = line.substr(start + 11, end - start - 11);
+        size_t fieldsStart = line.find("\"fields\":{");
+        if (fieldsStart != std::string_view::npos && start != std::string_view::npos && start > fieldsStart + 10)
+            fields = line.substr(fieldsStart + 9, start - 1 - fieldsStart - 9);
+    }
+
+    // The string value following key, which must include the opening quote.
+    static std::string_view field(std::string_view line, std::string_view key) {
+        size_t start = line.find(key);
+        if (start == std::string_view::npos) return {};
+        start += key.size();
+        size_t end = line.find('"', start);
+        return line.substr(start, end == std::string_view::npos ? 0 : end - start);
+    }
+};
+
+// Subscription of a client, parsed once from its "filter {...}" message:
+//   {"types":["ERROR","PANIC"], "min_severity":"MID", "activity_uuid":"12", "parent_uuid":"3",
+//    "text":"substring", "regex":"pattern", "fields":{"user":"bob","code":42}}
+// Every field is optional. text and regex are matched against the JSON-escaped message. Each of the
+// fields must be present with that value, compared in the form Logger::formatJson() renders it.
+// Filters run on the ingest threads, so a regex only sees the first max_regex_subject bytes of the
+// message, and patterns which need backtracking (back-references, nested quantifiers) are refused.
+struct ws_filter_t {
+    static constexpr size_t max_regex_subject = 4096;
+
+    uint32_t type_mask = ~0u;
+    int min_severity = 0;
+    std::optional<uint64_t> activity_uuid;
+    std::optional<uint64_t> parent_uuid;
+    std::string text;
+    std::optional<std::regex> regex;
+    std::vector<std::string> fields;   // "key":value, as rendered by vs_logger::field_json().
+
+    // Nullptr (no filtering) for an empty subscription, or if it is malformed.
+    static std::shared_ptr<const ws_filter_t> parse(std::string_view json) {
+        auto doc = crow::json::load(json.data(), json.size());
+        if (!doc || doc.t() != crow::json::type::Object) {
+            std::cerr << "WebSocket: Invalid filter: " << json << std::endl;
+            return nullptr;
+        }
+        if (doc.size() == 0) return nullptr;
+        try {
+            auto filter = std::make_shared<ws_filter_t>();
+            if (doc.has("types")) {
+                filter->type_mask = 0;
+                for (const auto& name : doc["types"])
+                    filter->type_mask |= 1u << known_level(std::string(name.s()), type_names);
+            }
+            if (doc.has("min_severity")) filter->min_severity = known_level(std::string(doc["min_severity"].s()), severity_names);
+            if (doc.has("activity_uuid")) filter->activity_uuid = std::stoull(std::string(doc["activity_uuid"].s()));
+            if (doc.has("parent_uuid")) filter->parent_uuid = std::stoull(std::string(doc["parent_uuid"].s()));
+            if (doc.has("text")) filter->text = std::string(doc["text"].s());
+            if (doc.has("regex")) {
+                std::string pattern(doc["regex"].s());
+                if (backtracking(pattern)) throw std::invalid_argument("regex needs backtracking: " + pattern);
+                filter->regex.emplace(pattern, regex_flags);
+            }
+            if (doc.has("fields")) {
+                for (const auto& item : doc["fields"]) filter->fields.push_back(field_needle(item));
+            }
+            return filter;
+        } catch (const std::exception& ex) {
+            std::cerr << "WebSocket: Invalid filter: " << ex.what() << std::endl;
+            return nullptr;
+        }
+    }
+
+    // Throws std::regex_error if the regex gives up on the message.
+    bool matches(std::string_view line) const {
+        ws_entry_t entry(line);
+        int type = level(entry.type, type_names);
+        if (type < 0 || !(type_mask & (1u << type))) return false;
+        if (level(entry.severity, severity_names) < min_severity) return false;
+        if (activity_uuid && entry.activity_uuid != *activity_uuid) return false;
+        if (parent_uuid && entry.parent_uuid != *parent_uuid) return false;
+        if (!text.empty() && entry.message.find(text) == std::string_view::npos) return false;
+        if (regex) {
+            auto subject = entry.message.substr(0, max_regex_subject);
+            if (!std::regex_search(subject.begin(), subject.end(), *regex)) return false;
+        }
+        for (const auto& needle : fields)
+            if (!has_field(entry.fields, needle)) return false;
+        return true;
+    }
+
+    // Keep the entries of a datagram matching the filter, returns how many there are.
+    size_t select(std::string_view datagram, std::string& out) const {
+        size_t count = 0;
+        for_each_line(datagram, [&](std::string_view line) {
+            if (matches(line)) {
+                out += line;
+                count++;
+            }
+        });
+        return count;
+    }
+
+private:
+#ifdef __GLIBCXX__
+    // libstdc++ matches recursively, one stack frame per character, unless asked for its polynomial executor.
+    static constexpr auto regex_flags = std::regex::optimize | std::regex_constants::__polynomial;
+#else
+    static constexpr auto regex_flags = std::regex::optimize;
+#endif
+
+    // Whether pattern has a back-reference, or a quantified group holding a quantifier itself as in
+    // "(a+)+": the ones a backtracking engine may take exponential time on.
+    static bool backtracking(std::string_view pattern) {
+        std::vector<bool> groups;    // For each open group, whether it holds a quantifier.
+        bool afterQuantifiedGroup = false;
+        for (size_t i = 0; i < pattern.size(); i++) {
+            char c = pattern[i];
+            bool closed = false;
+            if (c == '\\') {
+                if (i + 1 < pattern.size() && pattern[i + 1] >= '1' && pattern[i + 1] <= '9') return true;
+                i++;
+            }
+            else if (c == '[') {
+                // Skip the class, a ']' right at its start is a member.
+                i++;
+                if (i < pattern.size() && pattern[i] == '^') i++;
+                if (i < pattern.size() && pattern[i] == ']') i++;
+                while (i < pattern.size() && pattern[i] != ']') i += pattern[i] == '\\' ? 2 : 1;
+            }
+            else if (c == '(') {
+                groups.push_back(false);
+                if (i + 1 < pattern.size() && pattern[i + 1] == '?') i++;
+            }
+            else if (c == ')' && !groups.empty()) {
+                closed = groups.back();
+                groups.pop_back();
+                if (closed && !groups.empty()) groups.back() = true;
+            }
+            else if (c == '*' || c == '+' || c == '?' || c == '{') {
+                if (afterQuantifiedGroup) return true;
+                if (!groups.empty()) groups.back() = true;
+            }
+            afterQuantifiedGroup = closed;
+        }
+        return false;
+    }
+
+    static constexpr std::string_view type_names[] = {"OK", "INFO", "WARNING", "ERROR", "PANIC"};
+    static constexpr std::string_view severity_names[] = {"NONE", "LOW", "MID", "HIGH"};
+
+    // Position of name in names, or -1 if it is unknown.
+    template<size_t N>
+    static int level(std::string_view name, const std::string_view (&names)[N]) {
+        for (size_t i = 0; i < N; i++)
+            if (names[i] == name) return (int)i;
+        return -1;
+    }
+
+    // "key":value for a member of the "fields" filter, the value rendered as the producer would.
+    static std::string field_needle(const crow::json::rvalue& item) {
+        std::string key(item.key());
+        std::string needle = "\"";
+        vs_logger::escape_json(needle, key);
+        needle += "\":";
+        switch (item.t()) {
+            case crow::json::type::String:
+                vs_logger::field_json(needle, vs_logger::field_t(key, std::string(item.s())));
+                break;
+            case crow::json::type::Number:
+                if (item.nt() == crow::json::num_type::Signed_integer) vs_logger::field_json(needle, {key, item.i()});
+                else if (item.nt() == crow::json::num_type::Unsigned_integer) vs_logger::field_json(needle, {key, item.u()});
+                else vs_logger::field_json(needle, {key, item.d()});
+                break;
+            case crow::json::type::True:
+            case crow::json::type::False:
+                vs_logger::field_json(needle, {key, item.b()});
+                break;
+            default:
+                throw std::invalid_argument("unsupported value for field " + key);
+        }
+        return needle;
+    }
+
+    // Whether the fields object holds needle as one whole member. Keys and string values are escaped,
+    // so a bare quote following '{' or ',' always starts a key.
+    static bool has_field(std::string_view fields, std::string_view needle) {
+        for (size_t pos = fields.find(needle); pos != std::string_view::npos; pos = fields.find(needle, pos + 1)) {
+            size_t end = pos + needle.size();
+            if (pos > 0 && (fields[pos - 1] == '{' || fields[pos - 1] == ',') &&
+                end < fields.size() && (fields[end] == ',' || fields[end] == '}'))
+                return true;
+        }
+        return false;
+    }
+
+    template<size_t N>
+    static int known_level(std::string_view name, const std::string_view (&names)[N]) {
+        int value = level(name, names);
+        if (value < 0) throw std::invalid_argument("unknown level " + std::string(name));
+        return value;
+    }
+};
+
+}
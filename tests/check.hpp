@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+// Minimal assertions for the tests: report every failed check, and exit with a failure status at the end.
+
+inline int check_failures = 0;
+
+#define CHECK(condition)                                                                  \
+    do {                                                                                  \
+        if (!(condition)) {                                                               \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            check_failures++;                                                             \
+        }                                                                                 \
+    } while (0)
+
+inline int check_result() {
+    return check_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
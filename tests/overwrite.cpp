@@ -0,0 +1,60 @@
+// ASYNC mode with overflow_t::OVERWRITE: an entry thrown away to make room must not leave anything behind
+// in its queue cell. A deferred entry used to leave its renderer there, and the text entry filling the
+// cell next was rendered from the stale format string and arguments.
+
+#include <charconv>
+#include <filesystem>
+#include <string>
+
+#include "vs-logger/logger.hpp"
+#include "vs-logger/reader.hpp"
+#include "check.hpp"
+
+int main() {
+    auto path = std::filesystem::temp_directory_path() / "vs-logger-test-overwrite.log";
+    auto indexPath = path;
+    indexPath += ".idx";
+    std::filesystem::remove(path);
+    std::filesystem::remove(indexPath);
+
+    constexpr int count = 100000;
+    uint64_t dropped = 0;
+    {
+        Logger::config_t config;
+        config.mode = Logger::mode_t::ASYNC;
+        config.overflow = Logger::overflow_t::OVERWRITE;
+        config.queue_capacity = 4;
+        config.file_format = Logger::format_t::BINARY;
+        config.intern_formats = false;
+        Logger logger(path, std::nullopt, config);
+        for (int i = 0; i < count; i++) {
+            // Not a divisor of the capacity, so text entries also land in cells that held deferred ones.
+            if (i % 3 == 0) logger.log(Logger::type_t::INFO, Logger::severity_t::LOW, "plain message");
+            else logger.log(Logger::type_t::INFO, Logger::severity_t::LOW, 0, 0, "value {}", i);
+        }
+        logger.flush();
+        dropped = logger.metrics().dropped;
+    }
+    // Otherwise nothing was overwritten, and the test proves nothing.
+    CHECK(dropped > 0);
+
+    LogReader reader(path);
+    CHECK(reader.is_open());
+    CHECK(reader.size() > 0);
+    Logger::log_entry_t entry;
+    std::string message;
+    for (size_t pos = 0; pos < reader.size(); pos++) {
+        CHECK(reader.read(pos, entry, message));
+        if (message == "plain message") continue;
+        int value = -1;
+        bool deferred = message.starts_with("value ") &&
+                        std::from_chars(message.data() + 6, message.data() + message.size(), value).ptr ==
+                            message.data() + message.size();
+        // A stale renderer reads the text of the entry as its int argument, so bound the value as well.
+        CHECK(deferred && value >= 0 && value < count && value % 3 != 0);
+    }
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(indexPath);
+    return check_result();
+}
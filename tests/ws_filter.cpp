@@ -0,0 +1,44 @@
+// WebSocket filters run on the ingest threads: a pathological regex on a large message must neither
+// overflow the stack nor stall them, and patterns needing backtracking are refused up front.
+
+#include <string>
+
+#include "vs-logger/logger.hpp"
+#include "ws_filter.hpp"
+#include "check.hpp"
+
+static std::string entry_line(const std::string &message) {
+    Logger::log_entry_t entry{};
+    entry.type = Logger::type_t::INFO;
+    entry.sev = Logger::severity_t::LOW;
+    entry.timestamp = 1;
+    entry.activity_uuid = 1;
+    entry.seq_id = 1;
+    std::string line;
+    Logger::formatJson(line, entry, message);
+    return line;
+}
+
+int main() {
+    auto large = entry_line(std::string(200 * 1024, 'x'));
+
+    // Used to recurse once per character of the message, and crash.
+    auto alternation = vs_logger::ws_filter_t::parse(R"({"regex":"(x|y)*z"})");
+    CHECK(alternation != nullptr);
+    if (alternation) CHECK(!alternation->matches(large));
+
+    // Only the start of the message is searched.
+    auto head = vs_logger::ws_filter_t::parse(R"({"regex":"^x{16}"})");
+    CHECK(head != nullptr);
+    if (head) CHECK(head->matches(large));
+    auto tail = vs_logger::ws_filter_t::parse(R"({"regex":"y$"})");
+    CHECK(tail != nullptr);
+    if (tail) CHECK(!tail->matches(entry_line(std::string(200 * 1024, 'x') + "y")));
+
+    CHECK(vs_logger::ws_filter_t::parse(R"({"regex":"(x+)+z"})") == nullptr);
+    CHECK(vs_logger::ws_filter_t::parse(R"({"regex":"(?:x*y?)*z"})") == nullptr);
+    CHECK(vs_logger::ws_filter_t::parse(R"({"regex":"(x)\\1"})") == nullptr);
+    CHECK(vs_logger::ws_filter_t::parse(R"({"regex":"[(+]+x*"})") != nullptr);
+
+    return check_result();
+}
@@ -0,0 +1,88 @@
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "vs-logger/logger.hpp"
+#include "vs-logger/server.hpp"
+
+// Standalone log server: forwards the entries sent by any number of producer processes on their
+// UDS sockets to the web viewer. Producers can come and go, the sockets stay bound for the whole
+// lifetime of the daemon.
+
+static void usage(const char *name) {
+    std::cerr << "Usage: " << name << " [options] <uds path>...\n"
+                 "  --port N           HTTP/WebSocket port (default 18080)\n"
+                 "  --shards N         UDS shards per socket, as set in the producers' uds_shards (default 1)\n"
+                 "  --threads N        Crow worker threads (default 2)\n"
+                 "  --client-queue N   Entries queued per WebSocket client (default 8192)\n"
+                 "  --client-window N  Frames in flight per acknowledging client (default 4)\n"
+                 "  --history N        Recent entries kept for replay, 0 disables it (default 65536)\n"
+                 "  --history-bytes N  Memory limit of the replay history (default 16 MiB)\n"
+                 "  --deflate N        zlib level of deflated WebSocket streams, 0 disables them (default 6)\n"
+                 "  --log FILE         BINARY log file, served with its rotated segments on /logs and /activity/<uuid>\n";
+}
+
+template<typename T>
+static bool parse(std::string_view text, T &value) {
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc() && end == text.data() + text.size();
+}
+
+int main(int argc, char **argv) {
+    Logger::config_t config;
+    uint16_t port = 18080;
+    std::vector<std::filesystem::path> udsPaths;
+    std::optional<std::filesystem::path> logFilePath;
+
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            usage(argv[0]);
+            return 0;
+        }
+        if (!arg.starts_with("--")) {
+            udsPaths.emplace_back(arg);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+        std::string_view value = argv[++i];
+        bool ok;
+        if (arg == "--port") ok = parse(value, port);
+        else if (arg == "--shards") ok = parse(value, config.uds_shards) && config.uds_shards > 0;
+        else if (arg == "--threads") ok = parse(value, config.server_threads);
+        else if (arg == "--client-queue") ok = parse(value, config.ws_client_queue);
+        else if (arg == "--client-window") ok = parse(value, config.ws_client_window) && config.ws_client_window > 0;
+        else if (arg == "--log") {
+            logFilePath = value;
+            ok = !value.empty();
+        }
+        else if (arg == "--history") ok = parse(value, config.ws_history_entries);
+        else if (arg == "--history-bytes") ok = parse(value, config.ws_history_bytes);
+        else if (arg == "--deflate") ok = parse(value, config.ws_deflate_level) && config.ws_deflate_level >= 0 && config.ws_deflate_level <= 9;
+        else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            usage(argv[0]);
+            return 1;
+        }
+        if (!ok) {
+            std::cerr << "Invalid value for " << arg << ": " << value << std::endl;
+            return 1;
+        }
+    }
+
+    if (udsPaths.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    vs_logger::run_server(udsPaths, port, config, logFilePath);
+    return 0;
+}